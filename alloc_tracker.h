@@ -0,0 +1,253 @@
+#pragma once
+/* Opt-in allocation tracker: counts heap allocations per thread.
+
+   The tracker interposes malloc/calloc/realloc/free (and the aligned
+   variants) plus every global operator new/delete, and keeps thread_local
+   counters of allocations, bytes allocated and live/peak live bytes. Bytes
+   are counted with malloc_usable_size, i.e. what the allocator really handed
+   out (including its rounding), so frees can be matched without a header.
+
+   To enable it, define ALLOC_TRACKER_INTERPOSE in a single compilation unit
+   (.cpp) before including this file (directly or through benchmarking.h):
+        #define ALLOC_TRACKER_INTERPOSE
+        #include "alloc_tracker.h"
+
+   Then:
+    - benchmark::benchmark also reports allocations, bytes and peak live
+      bytes per invocation for each label.
+    - alloc_tracker::measure(iterations, func, args...) returns them.
+    - tests can require that a hot path does not allocate:
+        ASSERT_NO_ALLOCATIONS(tok.tokenize(line, ','));    // aborts if it does
+        bool ok = alloc_tracker::expect_no_allocations("tokenize", func, args...);
+
+   NOTE: glibc only (__libc_malloc and friends); counters are per thread, so
+   memory freed by another thread shows up as negative live bytes there.
+*/
+#include <cerrno>    // EINVAL, ENOMEM
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>  // malloc_usable_size
+#include <new>       // std::bad_alloc, std::nothrow_t
+#include <utility>   // std::forward
+
+namespace alloc_tracker {
+
+struct counters
+{
+    uint64_t allocations{0};
+    uint64_t deallocations{0};
+    uint64_t bytes_allocated{0};
+    int64_t live_bytes{0};
+    int64_t peak_live_bytes{0};
+};
+
+// NOTE: inline (not static) functions, so every compilation unit shares the
+// same function-local statics
+inline counters& local()
+{
+    thread_local counters c;
+    return c;
+}
+
+// true when ALLOC_TRACKER_INTERPOSE was defined in some compilation unit
+inline bool& interposed()
+{
+    static bool flag{false};
+    return flag;
+}
+
+namespace detail {
+inline void on_alloc(void* ptr)
+{
+    if (!ptr) return;
+    counters& c = local();
+    const int64_t bytes = ::malloc_usable_size(ptr);
+    ++c.allocations;
+    c.bytes_allocated += bytes;
+    c.live_bytes += bytes;
+    if (c.live_bytes > c.peak_live_bytes) c.peak_live_bytes = c.live_bytes;
+}
+
+inline void on_free(void* ptr)
+{
+    if (!ptr) return;
+    counters& c = local();
+    ++c.deallocations;
+    c.live_bytes -= ::malloc_usable_size(ptr);
+}
+} // namespace detail
+
+// per invocation averages (peak is the worst single invocation)
+struct stats
+{
+    double allocations{0};
+    double bytes_allocated{0};
+    int64_t peak_live_bytes{0};
+};
+
+// runs func 'iterations' times and reports what one invocation allocates
+template<typename TF, typename ... Args>
+static inline stats measure(uint64_t iterations, TF&& func, Args&&... args)
+{
+    counters& c = local();
+    const counters before = c;
+    int64_t peak{0};
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        const int64_t live = c.live_bytes;
+        c.peak_live_bytes = live;
+        func(std::forward<Args>(args)...);
+        if (c.peak_live_bytes - live > peak) peak = c.peak_live_bytes - live;
+    }
+    stats result;
+    result.allocations = double(c.allocations - before.allocations) / iterations;
+    result.bytes_allocated = double(c.bytes_allocated - before.bytes_allocated) / iterations;
+    result.peak_live_bytes = peak;
+    // restore the thread's real peak
+    if (before.peak_live_bytes > c.peak_live_bytes) c.peak_live_bytes = before.peak_live_bytes;
+    return result;
+}
+
+// true if a single call to func does not touch the heap (prints why not)
+template<typename TF, typename ... Args>
+static inline bool expect_no_allocations(const char* label, TF&& func, Args&&... args)
+{
+    if (!interposed())
+    {
+        fprintf(stderr, "%s: allocation tracking is not enabled (define ALLOC_TRACKER_INTERPOSE in one .cpp)\n", label);
+        return false;
+    }
+    const uint64_t before = local().allocations;
+    func(std::forward<Args>(args)...);
+    const uint64_t allocations = local().allocations - before;
+    if (allocations)
+    {
+        fprintf(stderr, "%s: expected no allocations, got %lu\n", label, allocations);
+        return false;
+    }
+    return true;
+}
+
+} // namespace alloc_tracker
+
+// aborts if 'code' allocates (or if tracking is not enabled)
+#define ASSERT_NO_ALLOCATIONS(code) { \
+          if (!alloc_tracker::expect_no_allocations(#code, [&]() { code; })) { \
+              fprintf(stderr, "%s:%d: ASSERT_NO_ALLOCATIONS failed\n", __FILE__, __LINE__); \
+              ::abort(); \
+          } \
+      }
+
+//{{{ Interposition, compiled in a single compilation unit
+#if defined(ALLOC_TRACKER_INTERPOSE) && !defined(ALLOC_TRACKER_INTERPOSED__)
+#define ALLOC_TRACKER_INTERPOSED__
+
+// glibc's real allocator entry points
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept
+{
+    void* ptr = __libc_malloc(size);
+    alloc_tracker::detail::on_alloc(ptr);
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    void* ptr = __libc_calloc(count, size);
+    alloc_tracker::detail::on_alloc(ptr);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    alloc_tracker::detail::on_free(ptr); // usable size must be read before
+    void* new_ptr = __libc_realloc(ptr, size);
+    if (!new_ptr && size)
+    { // failed: the old block is still there
+        alloc_tracker::detail::on_alloc(ptr);
+        return nullptr;
+    }
+    alloc_tracker::detail::on_alloc(new_ptr);
+    return new_ptr;
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    void* ptr = __libc_memalign(alignment, size);
+    alloc_tracker::detail::on_alloc(ptr);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+    void* ptr = memalign(alignment, size);
+    if (!ptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+void free(void* ptr) noexcept
+{
+    alloc_tracker::detail::on_free(ptr);
+    __libc_free(ptr);
+}
+} // extern "C"
+
+// operator new/delete go through the (tracked) functions above
+void* operator new(std::size_t size)
+{
+    void* ptr = ::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return ::malloc(size ? size : 1); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return ::malloc(size ? size : 1); }
+void operator delete(void* ptr) noexcept { ::free(ptr); }
+void operator delete[](void* ptr) noexcept { ::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { ::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { ::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { ::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { ::free(ptr); }
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* ptr = ::memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return ::memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return ::memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept { ::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { ::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { ::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { ::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { ::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { ::free(ptr); }
+#endif // __cpp_aligned_new
+
+// force insta-initialization pre-main
+static bool alloc_tracker_interposed = (alloc_tracker::interposed() = true);
+#endif // ALLOC_TRACKER_INTERPOSE
+//}}}
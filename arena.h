@@ -0,0 +1,334 @@
+#pragma once
+/* Allocators that keep hot paths off the global heap.
+
+   - monotonic_arena: bump pointer over one buffer (owned, or provided by the
+     caller, e.g. on the stack). Nothing is freed individually; take a
+     mark() and rewind() to it, or reset() once per request/message.
+   - fixed_pool<BLOCK_SIZE>: free list of fixed size blocks, grown in chunks.
+     fixed_pool<N>::local() is a thread_local instance, so no locking.
+     object_pool<T> is the typed front end (create/destroy).
+   - arena_resource / pool_resource: std::pmr::memory_resource adapters, so
+     any pmr-aware container (and string_utils::pmr, StringTokenizer) can
+     allocate from them. A pool_resource is bound to the pool of the thread
+     that constructed it.
+
+   Example (zero global heap allocations per message, once warmed up):
+    static char buffer[64*1024];
+    allocators::monotonic_arena arena(buffer, sizeof(buffer));
+    allocators::arena_resource resource(arena);
+    string_utils::pmr::StringTokenizer<> tok(&resource);
+    tok.reserve(64); // BEFORE the first mark: it must never grow inside a rewound scope
+    for (;;)
+    {
+        allocators::scoped_rewind rewind(arena); // frees everything below at scope exit
+        tok.tokenize(line, ',');
+        std::pmr::string padded = string_utils::pmr::pad_string(&resource, symbol, 12);
+        ...
+    }
+
+   NOTE: rewind/reset release everything allocated after the mark, whoever
+   owns it. Containers that outlive the scope (tokenizers, lookup tables)
+   must either use their own resource, or be reserve()d to their final size
+   before the arena's first mark().
+
+   NOTE: none of this is thread-safe. Blocks from a thread_local pool (through
+   object_pool or pool_resource) must be freed ON THE THREAD THAT ALLOCATED
+   them, and before that thread exits, as the pool frees its chunks then. Do
+   not hand pool or arena backed objects (e.g. pmr containers) to another
+   thread that frees them, as with the queues in ring_queue.h: move the data
+   out into memory owned by the receiver instead.
+*/
+#if __cplusplus < 201703L
+#error "arena.h needs C++17 (std::pmr)"
+#endif
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>         // std::bad_alloc, placement new
+#include <thread>      // std::this_thread::get_id
+#include <utility>     // std::forward
+#include "template_utils.h"
+
+namespace allocators {
+
+//{{{ helpers
+static inline constexpr std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+//}}}
+
+//{{{ monotonic_arena
+class monotonic_arena
+{
+public:
+    using marker = std::size_t;
+
+    // owns a buffer of 'capacity' bytes (one allocation, at construction)
+    explicit monotonic_arena(std::size_t capacity)
+        : owned_(static_cast<char*>(::operator new(capacity, std::align_val_t{CACHE_LINE_SIZE}))),
+          begin_(owned_), capacity_(capacity) {}
+
+    // uses a caller provided buffer, which must outlive the arena
+    monotonic_arena(void* buffer, std::size_t capacity)
+        : begin_(static_cast<char*>(buffer)), capacity_(capacity) {}
+
+    ~monotonic_arena()
+    {
+        if (owned_) ::operator delete(owned_, std::align_val_t{CACHE_LINE_SIZE});
+    }
+
+    // returns nullptr when exhausted (never throws, never touches the heap)
+    inline void* allocate(std::size_t bytes, std::size_t alignment=alignof(std::max_align_t)) noexcept
+    {
+        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(begin_);
+        const std::size_t offset = align_up(base + used_, alignment) - base;
+        if (offset + bytes > capacity_) return nullptr;
+        used_ = offset + bytes;
+        high_water_ = extrema::max(high_water_, used_);
+        return begin_ + offset;
+    }
+
+    inline bool owns(const void* ptr) const
+    {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= begin_ && p < begin_ + capacity_;
+    }
+
+    // everything allocated after mark() is released by rewind(mark)
+    inline marker mark() const { return used_; }
+    inline void rewind(marker m) { if (m < used_) used_ = m; }
+    inline void reset() { used_ = 0; }
+
+    inline std::size_t used() const { return used_; }
+    inline std::size_t remaining() const { return capacity_ - used_; }
+    inline std::size_t capacity() const { return capacity_; }
+    inline std::size_t high_water() const { return high_water_; }
+
+private:
+    // not copiable
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    char* owned_{nullptr};
+    char* begin_{nullptr};
+    std::size_t capacity_{0};
+    std::size_t used_{0};
+    std::size_t high_water_{0};
+};
+
+// RAII - rewinds the arena to where it was at construction
+struct scoped_rewind
+{
+    explicit scoped_rewind(monotonic_arena& arena) : arena_(arena), mark_(arena.mark()) {}
+    ~scoped_rewind() { arena_.rewind(mark_); }
+
+    private:
+    // not copiable
+    scoped_rewind& operator=(const scoped_rewind &) = delete;
+    scoped_rewind(const scoped_rewind &) = delete;
+    scoped_rewind() = delete;
+    monotonic_arena& arena_;
+    monotonic_arena::marker mark_;
+};
+
+// pmr adapter. When the arena is exhausted, falls back to 'upstream', which
+// by default throws std::bad_alloc (so running out never hits the heap silently).
+class arena_resource : public std::pmr::memory_resource
+{
+public:
+    explicit arena_resource(monotonic_arena& arena, std::pmr::memory_resource* upstream=std::pmr::null_memory_resource())
+        : arena_(arena), upstream_(upstream) {}
+
+    // how many allocations did not fit in the arena
+    inline std::size_t overflows() const { return overflows_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (void* ptr = arena_.allocate(bytes, alignment)) return ptr;
+        ++overflows_;
+        return upstream_->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        // arena memory is released by rewind/reset only
+        if (!arena_.owns(ptr)) upstream_->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    monotonic_arena& arena_;
+    std::pmr::memory_resource* upstream_;
+    std::size_t overflows_{0};
+};
+//}}}
+
+//{{{ fixed_pool
+template <std::size_t BLOCK_SIZE, std::size_t BLOCKS_PER_CHUNK=256>
+class fixed_pool
+{
+    static_assert(BLOCKS_PER_CHUNK > 0, "fixed_pool needs at least one block per chunk");
+
+public:
+    // every block can hold a free list link, and is max_align_t aligned
+    static constexpr std::size_t block_size = align_up(extrema::max(BLOCK_SIZE, sizeof(void*)), alignof(std::max_align_t));
+    static constexpr std::size_t block_alignment = alignof(std::max_align_t);
+
+    fixed_pool() = default;
+
+    ~fixed_pool()
+    {
+        while (chunks_)
+        {
+            chunk* next = chunks_->next;
+            ::operator delete(chunks_);
+            chunks_ = next;
+        }
+    }
+
+    // only touches the heap when the free list is empty (one chunk at a time)
+    inline void* allocate()
+    {
+        if (!free_) grow();
+        node* block = free_;
+        free_ = block->next;
+        ++in_use_;
+        return block;
+    }
+
+    inline void deallocate(void* ptr)
+    {
+        node* block = static_cast<node*>(ptr);
+        block->next = free_;
+        free_ = block;
+        --in_use_;
+    }
+
+    // pre-allocates enough chunks for 'blocks' blocks (e.g. at startup)
+    inline void reserve(std::size_t blocks)
+    {
+        while (capacity_ - in_use_ < blocks) grow();
+    }
+
+    inline std::size_t in_use() const { return in_use_; }
+    inline std::size_t capacity() const { return capacity_; }
+
+    static inline fixed_pool& local()
+    {
+        thread_local fixed_pool pool;
+        return pool;
+    }
+
+private:
+    // not copiable
+    fixed_pool(const fixed_pool&) = delete;
+    fixed_pool& operator=(const fixed_pool&) = delete;
+
+    struct node { node* next; };
+    struct chunk { chunk* next; };
+    static constexpr std::size_t header_size = align_up(sizeof(chunk), block_alignment);
+
+    void grow()
+    {
+        char* memory = static_cast<char*>(::operator new(header_size + block_size * BLOCKS_PER_CHUNK));
+        chunk* c = reinterpret_cast<chunk*>(memory);
+        c->next = chunks_;
+        chunks_ = c;
+        for (std::size_t i = BLOCKS_PER_CHUNK; i > 0; --i)
+        { // push in reverse, so blocks are handed out in address order
+            node* block = reinterpret_cast<node*>(memory + header_size + (i - 1) * block_size);
+            block->next = free_;
+            free_ = block;
+        }
+        capacity_ += BLOCKS_PER_CHUNK;
+    }
+
+    node* free_{nullptr};
+    chunk* chunks_{nullptr};
+    std::size_t in_use_{0};
+    std::size_t capacity_{0};
+};
+
+// typed front end over the thread_local pool for sizeof(T)
+template <typename T, std::size_t BLOCKS_PER_CHUNK=256>
+struct object_pool
+{
+    static_assert(alignof(T) <= alignof(std::max_align_t), "object_pool does not support over-aligned types");
+    using pool_type = fixed_pool<sizeof(T), BLOCKS_PER_CHUNK>;
+
+    template <typename... Args>
+    static inline T* create(Args&&... args)
+    {
+        void* memory = pool_type::local().allocate();
+        try
+        {
+            return new (memory) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            pool_type::local().deallocate(memory);
+            throw;
+        }
+    }
+
+    static inline void destroy(T* object)
+    {
+        if (!object) return;
+        object->~T();
+        pool_type::local().deallocate(object);
+    }
+};
+
+// pmr adapter: requests that fit in a block come from the pool of the thread
+// that constructed the resource; anything bigger (or over-aligned) goes to
+// 'upstream'. Single thread: only allocate/deallocate through it on that
+// thread (asserted in debug builds), and do not let it outlive that thread.
+template <std::size_t BLOCK_SIZE, std::size_t BLOCKS_PER_CHUNK=256>
+class pool_resource : public std::pmr::memory_resource
+{
+public:
+    using pool_type = fixed_pool<BLOCK_SIZE, BLOCKS_PER_CHUNK>;
+
+    explicit pool_resource(std::pmr::memory_resource* upstream=std::pmr::get_default_resource())
+        : pool_(pool_type::local()), owner_(std::this_thread::get_id()), upstream_(upstream) {}
+
+private:
+    static inline bool fits(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes <= pool_type::block_size && alignment <= pool_type::block_alignment;
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (!fits(bytes, alignment)) return upstream_->allocate(bytes, alignment);
+        assert(std::this_thread::get_id() == owner_ && "pool_resource used from another thread");
+        return pool_.allocate();
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        if (!fits(bytes, alignment)) return upstream_->deallocate(ptr, bytes, alignment);
+        assert(std::this_thread::get_id() == owner_ && "pool_resource used from another thread");
+        pool_.deallocate(ptr);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        // instances bound to the same pool can free each other's blocks
+        const pool_resource* pool = dynamic_cast<const pool_resource*>(&other);
+        return pool && &pool->pool_ == &pool_ && pool->upstream_ == upstream_;
+    }
+
+    pool_type& pool_;
+    std::thread::id owner_;
+    std::pmr::memory_resource* upstream_;
+};
+//}}}
+
+} // namespace allocators
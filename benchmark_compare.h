@@ -0,0 +1,168 @@
+#pragma once
+/* A/B comparison of competing implementations, on top of benchmarking.h.
+
+   benchmark::benchmark() runs implementations one after the other, so any
+   drift in between (temperature, frequency, a noisy neighbour) ends up in
+   the comparison. compare() instead:
+    - checks that every implementation returns the same as the first one
+      (the baseline), for the given arguments
+    - runs ROUNDS rounds on the same (pinned) cpu; in each round every
+      implementation runs one batch of BATCH calls, in a random order
+    - compares each implementation with the baseline round by round, so
+      drift shared by a round cancels out, and reports the speedup (geometric
+      mean of the per round ratios) with its confidence interval
+
+   Example:
+    #include "benchmark_compare.h"
+    int main()
+    {
+        benchmark::compare("pad_string", {}, std::make_tuple(std::string("abc"), 10, '0', true),
+                           benchmark::implementation("v1", string_utils::v1::pad_string),
+                           benchmark::implementation("v2", string_utils::v2::pad_string));
+    }
+
+   Prints one line per implementation:
+    v1: 40.50 ns per call (median);  1.00x baseline
+    v2: 21.00 ns per call (median);  1.93x vs v1 [1.90x, 1.96x] CI
+*/
+#include <cmath>       // std::log, std::exp, std::sqrt
+#include <functional>  // std::function
+#include <numeric>     // std::iota
+#include <random>      // std::mt19937
+#include <tuple>
+#include <type_traits>
+#include <utility>     // std::index_sequence
+#include <vector>
+#include "benchmarking.h"
+
+namespace benchmark {
+
+struct compare_options
+{
+    uint32_t rounds{200};       // interleaved rounds (samples per implementation)
+    uint64_t batch{1000};       // calls per implementation per round
+    uint32_t warmup_rounds{2};  // rounds run first and not recorded
+    double z{1.96};             // confidence interval width, in standard errors (1.96 ~ 95%)
+    uint32_t seed{42};          // shuffles the order within each round
+};
+
+template <typename TF>
+struct candidate
+{
+    const char* name;
+    TF func;
+};
+
+template <typename TF>
+static inline candidate<typename std::decay<TF>::type> implementation(const char* name, TF&& func)
+{
+    return candidate<typename std::decay<TF>::type>{name, std::forward<TF>(func)};
+}
+
+namespace compare_detail {
+
+template <typename TF, typename Tuple, std::size_t ... I>
+static inline auto invoke(TF& func, Tuple& args, std::index_sequence<I...>) -> decltype(func(std::get<I>(args)...))
+{
+    return func(std::get<I>(args)...);
+}
+
+template <typename Tuple>
+using indices = std::make_index_sequence<std::tuple_size<Tuple>::value>;
+
+// nothing to compare for functions returning void
+template <typename Tuple, typename First, typename ... Rest>
+static inline bool same_outputs(std::true_type, Tuple&, First&, Rest&...)
+{
+    return true;
+}
+
+template <typename Tuple, typename First, typename ... Rest>
+static inline bool same_outputs(std::false_type, Tuple& args, First& baseline, Rest&... others)
+{
+    const auto expected = invoke(baseline.func, args, indices<Tuple>{});
+    bool same = true;
+    int expand[] = {0, ((invoke(others.func, args, indices<Tuple>{}) == expected)
+                        ? 0 : (printf("WARNING: %s does not return the same as %s\n", others.name, baseline.name), same = false, 0))...};
+    (void)expand;
+    return same;
+}
+
+// one batch of 'batch' calls, in ticks
+template <typename TF, typename Tuple>
+static inline std::function<uint64_t()> batch_runner(candidate<TF>& c, Tuple& args, uint64_t batch)
+{
+    return [&c, &args, batch]() {
+        uint64_t start = rdtsc();
+        for (uint64_t i = 0; i < batch; ++i) invoke(c.func, args, indices<Tuple>{});
+        return rdtsc() - start;
+    };
+}
+
+static inline double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+} // namespace compare_detail
+
+/** compares implementations of the same signature (the first one is the
+    baseline) called with 'args'; returns false if their outputs differ */
+template <typename ... Args, typename First, typename ... Rest>
+static inline bool compare(const char* label, const compare_options& options, std::tuple<Args...> args,
+                           candidate<First> baseline, candidate<Rest>... others)
+{
+    using result_type = decltype(compare_detail::invoke(baseline.func, args, compare_detail::indices<std::tuple<Args...>>{}));
+    prepare_environment();
+    const int cpu = sched_getcpu();
+    const uint32_t rounds = options.rounds > 1 ? options.rounds : 2;
+    const uint64_t batch = options.batch ? options.batch : 1;
+
+    printf("%s: comparing %zu implementations, %u rounds of %lu calls\n", label, sizeof...(Rest) + 1, rounds, batch);
+    const bool same = compare_detail::same_outputs(std::is_void<result_type>{}, args, baseline, others...);
+
+    std::vector<const char*> names{baseline.name, others.name...};
+    std::vector<std::function<uint64_t()>> runners{compare_detail::batch_runner(baseline, args, batch),
+                                                   compare_detail::batch_runner(others, args, batch)...};
+    std::vector<std::vector<double>> per_call(runners.size(), std::vector<double>(rounds)); // ticks, [implementation][round]
+    std::vector<std::size_t> order(runners.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 rng(options.seed);
+
+    for (uint32_t round = 0; round < options.warmup_rounds + rounds; ++round)
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+        for (std::size_t index : order)
+        {
+            const uint64_t ticks = runners[index]();
+            if (round < options.warmup_rounds) continue;
+            per_call[index][round - options.warmup_rounds] = (ticks > RDTSC_COST ? double(ticks - RDTSC_COST) : 0.0) / batch;
+        }
+    }
+    warn_on_migration(label, cpu);
+
+    printf("%17s: %8.02f ns per call (median); %5.2fx baseline\n",
+           names[0], get_nanos_from_ticks(1) * compare_detail::median(per_call[0]), 1.0);
+    for (std::size_t k = 1; k < runners.size(); ++k)
+    { // geometric mean of the paired (same round) ratios, with a normal CI on the log scale
+        double sum{0}, sum_squares{0};
+        for (uint32_t round = 0; round < rounds; ++round)
+        {
+            const double ratio = std::log((per_call[0][round] + 1e-9) / (per_call[k][round] + 1e-9));
+            sum += ratio;
+            sum_squares += ratio * ratio;
+        }
+        const double mean = sum / rounds;
+        const double variance = (sum_squares - rounds * mean * mean) / (rounds - 1);
+        const double margin = options.z * std::sqrt(variance > 0 ? variance : 0) / std::sqrt(double(rounds));
+        const bool significant = (mean - margin > 0) || (mean + margin < 0);
+        printf("%17s: %8.02f ns per call (median); %5.2fx vs %s [%0.2fx, %0.2fx] CI%s\n",
+               names[k], get_nanos_from_ticks(1) * compare_detail::median(per_call[k]),
+               std::exp(mean), names[0], std::exp(mean - margin), std::exp(mean + margin),
+               significant ? "" : " (not significant)");
+    }
+    return same;
+}
+
+} // namespace benchmark
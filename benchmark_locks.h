@@ -0,0 +1,80 @@
+#pragma once
+/* Lock contention benchmark, on top of benchmarking.h.
+
+   For 1..N threads (each pinned to its own cpu when possible), every thread
+   takes the lock OPS times around a tiny critical section (++counter). The
+   reported cost is the wall time divided by the total number of
+   acquisitions, so it shows how throughput degrades with contention.
+
+   Example:
+    #include "benchmark_locks.h"
+    int main()
+    {
+        benchmark::lock_contention_all(4); // 1..4 threads, every lock in locks.h
+        benchmark::lock_contention<locks::ticket_lock>("ticket_lock", 8);
+    }
+*/
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "benchmarking.h"
+#include "locks.h"
+
+namespace benchmark {
+
+// How many acquisitions per thread?
+constexpr uint64_t LOCK_OPS_PER_THREAD{1000000ULL};
+
+template <typename Lock>
+static inline void lock_contention(const char* label, unsigned max_threads=std::thread::hardware_concurrency(), uint64_t ops=LOCK_OPS_PER_THREAD)
+{
+    const std::vector<int> cpus = available_cpus();
+    for (unsigned threads = 1; threads <= max_threads; ++threads)
+    {
+        Lock lock{};
+        uint64_t counter{0};
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> go{false};
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                if (!cpus.empty()) pin_to_cpu(cpus[t % cpus.size()]);
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) locks::cpu_relax();
+                for (uint64_t i = 0; i < ops; ++i)
+                {
+                    locks::lock_guard<Lock> guard(lock);
+                    ++counter;
+                }
+            });
+        }
+        while (ready.load() < threads) locks::cpu_relax();
+
+        uint64_t start = rdtsc();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers) worker.join();
+        uint64_t ticks = rdtsc() - start;
+
+        const uint64_t total_ops = ops * threads;
+        const double ns_per_op = get_nanos_from_ticks(ticks) / total_ops;
+        printf("%8.02f ns per lock/unlock; %8.02f Mops/s; %17s with (%02u) threads%s\n",
+               ns_per_op, 1e3 / ns_per_op, label, threads,
+               (counter == total_ops ? "" : " <-- BROKEN: lost updates!"));
+    }
+}
+
+static inline void lock_contention_all(unsigned max_threads=std::thread::hardware_concurrency(), uint64_t ops=LOCK_OPS_PER_THREAD)
+{
+    lock_contention<locks::spin_lock>("spin_lock", max_threads, ops);
+    lock_contention<locks::ticket_lock>("ticket_lock", max_threads, ops);
+    lock_contention<locks::mcs_lock>("mcs_lock", max_threads, ops);
+    lock_contention<locks::adaptive_mutex>("adaptive_mutex", max_threads, ops);
+    lock_contention<pthread_mutex_t>("pthread_mutex_t", max_threads, ops);
+    lock_contention<std::mutex>("std::mutex", max_threads, ops);
+}
+
+} // namespace benchmark
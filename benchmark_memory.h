@@ -0,0 +1,446 @@
+#pragma once
+/* Memory hierarchy probes, on top of benchmarking.h.
+
+   - memory_latency:   pointer chasing through a random cyclic permutation
+                       (one pointer per cache line), per working set size.
+                       Jumps in latency ('knees') mark where L1/L2/L3 end,
+                       labelled with the cache sizes sysfs reports.
+   - memory_bandwidth: sequential and random read/write bandwidth per size.
+   - tlb_reach:        one access per 4K page in random order, with 4K pages
+                       and with huge pages (MAP_HUGETLB, else THP madvise,
+                       checked against AnonHugePages in /proc/self/smaps);
+                       latency goes up once the pages no longer fit the TLB.
+   - core_ping_pong:   one cache line bounced between two pinned cpus,
+                       for every cpu pair; one-way latency matrix.
+
+   memory_hierarchy_report() runs all of them and prints tables meant to be
+   archived per host type (the header lists host, cpu model and cache sizes).
+
+   Example:
+    #include "benchmark_memory.h"
+    int main()
+    {
+        benchmark::memory_hierarchy_report(); // taskset / pin first, see benchmarking.h
+    }
+*/
+#include <algorithm>    // std::swap
+#include <atomic>
+#include <cctype>       // std::isxdigit, std::isupper
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>      // std::strtoul, std::atoi
+#include <cstring>      // memset
+#include <fstream>      // /proc/cpuinfo
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>   // mmap, madvise
+#include <unistd.h>     // gethostname, sysconf
+#include "benchmarking.h"
+#include "cache_utils.h"
+
+namespace benchmark {
+
+// Working sets probed (doubling) and how long each probe runs
+constexpr std::size_t MEMORY_MIN_BYTES{4*1024UL};
+constexpr std::size_t MEMORY_MAX_BYTES{256*1024*1024UL};
+constexpr uint64_t MEMORY_CHASE_STEPS{4000000ULL};
+constexpr std::size_t PAGE_SIZE_4K{4096};
+constexpr std::size_t PAGE_SIZE_2M{2*1024*1024UL};
+constexpr uint64_t PING_PONG_ROUND_TRIPS{20000ULL};
+constexpr uint64_t PING_PONG_WARMUP_ROUND_TRIPS{1000ULL};
+
+//{{{ buffers
+// page aligned anonymous memory; with 'huge' it tries explicit huge pages
+// first (needs vm.nr_hugepages), then transparent huge pages
+struct mapped_buffer
+{
+    mapped_buffer(std::size_t bytes, bool huge=false) : size(bytes)
+    {
+        if (huge)
+        {
+            size = (bytes + PAGE_SIZE_2M - 1) & ~(PAGE_SIZE_2M - 1);
+            data = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+            if (data != MAP_FAILED) { kind = "hugetlb"; }
+            else
+            {
+                data = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+                if (data != MAP_FAILED) thp = (::madvise(data, size, MADV_HUGEPAGE) == 0);
+            }
+        }
+        else
+        {
+            data = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (data != MAP_FAILED) ::madvise(data, size, MADV_NOHUGEPAGE);
+        }
+        if (data == MAP_FAILED) { data = nullptr; size = 0; return; }
+        ::memset(data, 0, size); // fault every page in now, not while measuring
+        // madvise is only a hint: only call it thp if the kernel did back it with huge pages
+        if (thp) kind = (anon_huge_kb(data) > 0 ? "thp" : "4k, no thp");
+    }
+    ~mapped_buffer() { if (data) ::munmap(data, size); }
+
+    mapped_buffer(const mapped_buffer&) = delete;
+    mapped_buffer& operator=(const mapped_buffer&) = delete;
+
+    void* data{nullptr};
+    std::size_t size{0};
+    const char* kind{"4k"};
+
+private:
+    bool thp{false};
+
+    // AnonHugePages (kB) of the mapping holding 'address', from /proc/self/smaps
+    static inline std::size_t anon_huge_kb(const void* address)
+    {
+        const uintptr_t target = reinterpret_cast<uintptr_t>(address);
+        std::ifstream smaps("/proc/self/smaps");
+        bool inside = false;
+        for (std::string line; std::getline(smaps, line); )
+        {
+            unsigned long start{}, end{};
+            if (!line.empty() && std::isxdigit(static_cast<unsigned char>(line[0])) && !std::isupper(static_cast<unsigned char>(line[0]))
+                && ::sscanf(line.c_str(), "%lx-%lx", &start, &end) == 2)
+            { // a mapping header: "start-end perms offset dev inode path"
+                inside = (start <= target && target < end);
+            }
+            else if (inside && line.compare(0, 14, "AnonHugePages:") == 0)
+            {
+                return std::strtoul(line.c_str() + 14, nullptr, 10);
+            }
+        }
+        return 0;
+    }
+};
+
+// links one pointer every 'stride' bytes into a single random cycle
+// (Sattolo's algorithm), so the hardware prefetchers cannot guess the next one
+static inline void** build_chase(void* buffer, std::size_t bytes, std::size_t stride)
+{
+    const std::size_t nodes = bytes / stride;
+    std::vector<std::size_t> order(nodes);
+    for (std::size_t i = 0; i < nodes; ++i) order[i] = i;
+    std::mt19937_64 rng(nodes);
+    for (std::size_t i = nodes - 1; i > 0; --i)
+    {
+        std::swap(order[i], order[rng() % i]);
+    }
+    char* base = static_cast<char*>(buffer);
+    for (std::size_t i = 0; i < nodes; ++i)
+    {
+        *reinterpret_cast<void**>(base + order[i] * stride) = base + order[(i + 1) % nodes] * stride;
+    }
+    return reinterpret_cast<void**>(base + order[0] * stride);
+}
+
+// ns per dependent load
+static inline double chase(void** start, uint64_t steps)
+{
+    void** p = start;
+    for (uint64_t i = 0; i < steps / 4; ++i) p = static_cast<void**>(*p); // warm up
+    uint64_t begin = rdtsc();
+    for (uint64_t i = 0; i < steps; ++i) p = static_cast<void**>(*p);
+    uint64_t ticks = rdtsc() - begin;
+    asm volatile("" :: "r"(p)); // keep the chain alive
+    return get_nanos_from_ticks(ticks) / steps;
+}
+
+static inline std::string human_bytes(std::size_t bytes)
+{
+    char buf[32];
+    if (bytes >= (1UL<<30)) snprintf(buf, sizeof(buf), "%zuG", bytes >> 30);
+    else if (bytes >= (1UL<<20)) snprintf(buf, sizeof(buf), "%zuM", bytes >> 20);
+    else snprintf(buf, sizeof(buf), "%zuK", bytes >> 10);
+    return buf;
+}
+//}}}
+
+//{{{ host / topology
+
+static inline void print_host_topology()
+{
+    char host[256]{};
+    ::gethostname(host, sizeof(host) - 1);
+    std::string model;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; model.empty() && std::getline(cpuinfo, line); )
+    {
+        if (line.compare(0, 10, "model name") == 0) model = line.substr(line.find(':') + 2);
+    }
+    printf("host: %s; cpu: %s; online cpus: %ld; allowed cpus: %zu\n",
+           host, model.c_str(), ::sysconf(_SC_NPROCESSORS_ONLN), available_cpus().size());
+
+    const int cpu = sched_getcpu();
+    for (int index = 0; ; ++index)
+    {
+        const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index) + "/";
+        const std::string level = read_sysfs(dir + "level");
+        if (level.empty()) break;
+        printf("  L%s %-12s %6s; line %3s bytes; %2s-way; shared with cpus %s\n",
+               level.c_str(), read_sysfs(dir + "type").c_str(), read_sysfs(dir + "size").c_str(),
+               read_sysfs(dir + "coherency_line_size").c_str(), read_sysfs(dir + "ways_of_associativity").c_str(),
+               read_sysfs(dir + "shared_cpu_list").c_str());
+    }
+}
+
+struct cache_level
+{
+    int level;
+    std::size_t bytes;
+};
+
+// data (or unified) caches of 'cpu' from sysfs, innermost first
+static inline std::vector<cache_level> data_cache_levels(int cpu)
+{
+    std::vector<cache_level> levels;
+    for (int index = 0; ; ++index)
+    {
+        const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index) + "/";
+        const std::string level = read_sysfs(dir + "level");
+        if (level.empty()) break;
+        if (read_sysfs(dir + "type") == "Instruction") continue;
+        const std::size_t bytes = parse_cache_size(read_sysfs(dir + "size"));
+        if (bytes) levels.push_back(cache_level{std::atoi(level.c_str()), bytes});
+    }
+    std::sort(levels.begin(), levels.end(), [](const cache_level& x, const cache_level& y) { return x.level < y.level; });
+    return levels;
+}
+
+// "L2 -> L3": the level a working set of 'bytes' no longer fits, and where it goes
+static inline std::string knee_label(const std::vector<cache_level>& levels, std::size_t bytes)
+{
+    std::size_t outgrown = 0; // levels no larger than 'bytes' (a set as big as the cache already misses)
+    while (outgrown < levels.size() && levels[outgrown].bytes <= bytes) ++outgrown;
+    if (levels.empty()) return "?";
+    if (outgrown == 0) return "within L" + std::to_string(levels[0].level);
+    const std::string from = "L" + std::to_string(levels[outgrown - 1].level);
+    return from + " -> " + (outgrown < levels.size() ? "L" + std::to_string(levels[outgrown].level) : std::string("DRAM"));
+}
+//}}}
+
+//{{{ latency
+static inline void memory_latency(std::size_t min_bytes=MEMORY_MIN_BYTES, std::size_t max_bytes=MEMORY_MAX_BYTES, uint64_t steps=MEMORY_CHASE_STEPS)
+{
+    printf("%10s %12s\n", "working set", "ns per load");
+    std::vector<std::size_t> sizes;
+    std::vector<double> latencies;
+    for (std::size_t bytes = min_bytes; bytes <= max_bytes; bytes <<= 1)
+    {
+        mapped_buffer buffer(bytes);
+        if (!buffer.data) break;
+        const double ns = chase(build_chase(buffer.data, bytes, CACHE_LINE_SIZE), steps);
+        sizes.push_back(bytes);
+        latencies.push_back(ns);
+        printf("%10s %12.02f\n", human_bytes(bytes).c_str(), ns);
+    }
+
+    // knee detection: a level ends where latency jumps by 50%+ from the
+    // previous size; every jump is reported (consecutive sizes can each cross
+    // a level), labelled with the levels sysfs gives for this cpu
+    const std::vector<cache_level> levels = data_cache_levels(sched_getcpu());
+    printf("knees (estimated end of each level):");
+    for (std::size_t i = 1; i < latencies.size(); ++i)
+    {
+        if (latencies[i] > latencies[i - 1] * 1.5)
+        {
+            printf(" %s (%.02f ns -> %.02f ns, %s)", human_bytes(sizes[i - 1]).c_str(), latencies[i - 1], latencies[i],
+                   knee_label(levels, sizes[i]).c_str());
+        }
+    }
+    printf("\n");
+}
+//}}}
+
+//{{{ bandwidth
+enum class access_pattern : uint8_t { SEQUENTIAL_READ, SEQUENTIAL_WRITE, RANDOM_READ, RANDOM_WRITE };
+
+// every pattern runs the same per line kernel (a whole line, the same width,
+// several accumulators or independent stores); only the order of the lines differs
+constexpr std::size_t WORDS_PER_LINE{CACHE_LINE_SIZE / sizeof(uint64_t)};
+static_assert(WORDS_PER_LINE % 4 == 0, "the read kernel uses 4 accumulators");
+
+template <typename TIndex>
+static inline void read_lines(const uint64_t* words, std::size_t lines, TIndex line_index, uint64_t (&sums)[4])
+{
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        const uint64_t* line = words + line_index(i) * WORDS_PER_LINE;
+        for (std::size_t w = 0; w < WORDS_PER_LINE; w += 4)
+        {
+            sums[0] += line[w];
+            sums[1] += line[w + 1];
+            sums[2] += line[w + 2];
+            sums[3] += line[w + 3];
+        }
+    }
+}
+
+template <typename TIndex>
+static inline void write_lines(uint64_t* words, std::size_t lines, TIndex line_index)
+{
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        uint64_t* line = words + line_index(i) * WORDS_PER_LINE;
+        for (std::size_t w = 0; w < WORDS_PER_LINE; ++w) line[w] = i + w;
+    }
+}
+
+// GB/s moving 'bytes' (at least 'min_total' bytes moved in total)
+static inline double bandwidth(void* buffer, std::size_t bytes, access_pattern pattern, std::size_t min_total=1UL<<30)
+{
+    uint64_t* words = static_cast<uint64_t*>(buffer);
+    const std::size_t lines = bytes / CACHE_LINE_SIZE;
+    const std::size_t passes = extrema::max<std::size_t>(1, min_total / bytes);
+    uint64_t sums[4]{};
+
+    auto sequential_line = [](std::size_t i) { return i; };
+    // random: whole cache lines, scattered by an odd multiplier (a bijection
+    // modulo a power of two 'lines'), so the index math stays off the critical path
+    auto random_line = [lines](std::size_t i) { return (i * 2862933555777941757ULL + 3037000493ULL) & (lines - 1); };
+
+    uint64_t begin = rdtsc();
+    for (std::size_t pass = 0; pass < passes; ++pass)
+    {
+        switch (pattern)
+        {
+        case access_pattern::SEQUENTIAL_READ:  read_lines(words, lines, sequential_line, sums); break;
+        case access_pattern::SEQUENTIAL_WRITE: write_lines(words, lines, sequential_line); break;
+        case access_pattern::RANDOM_READ:      read_lines(words, lines, random_line, sums); break;
+        case access_pattern::RANDOM_WRITE:     write_lines(words, lines, random_line); break;
+        }
+        asm volatile("" ::: "memory");
+    }
+    uint64_t ticks = rdtsc() - begin;
+    const uint64_t sink = sums[0] + sums[1] + sums[2] + sums[3];
+    asm volatile("" :: "r"(sink));
+    return double(bytes) * passes / get_nanos_from_ticks(ticks); // bytes per ns == GB/s
+}
+
+static inline void memory_bandwidth(std::size_t min_bytes=MEMORY_MIN_BYTES<<2, std::size_t max_bytes=MEMORY_MAX_BYTES)
+{
+    printf("%10s %12s %12s %12s %12s (GB/s)\n", "working set", "seq read", "seq write", "rand read", "rand write");
+    for (std::size_t bytes = min_bytes; bytes <= max_bytes; bytes <<= 2)
+    {
+        mapped_buffer buffer(bytes);
+        if (!buffer.data) break;
+        printf("%10s %12.02f %12.02f %12.02f %12.02f\n", human_bytes(bytes).c_str(),
+               bandwidth(buffer.data, bytes, access_pattern::SEQUENTIAL_READ),
+               bandwidth(buffer.data, bytes, access_pattern::SEQUENTIAL_WRITE),
+               bandwidth(buffer.data, bytes, access_pattern::RANDOM_READ),
+               bandwidth(buffer.data, bytes, access_pattern::RANDOM_WRITE));
+    }
+}
+//}}}
+
+//{{{ TLB reach
+// one pointer per 4K page: each load needs a different translation, so once
+// 'pages' exceeds the TLB entries every load pays a page walk (with 4K pages);
+// with huge pages the same span needs 512x fewer entries
+static inline void tlb_reach(std::size_t max_pages=16384, uint64_t steps=MEMORY_CHASE_STEPS)
+{
+    printf("%10s %10s %14s %14s\n", "pages", "span", "ns (4k pages)", "ns (huge)");
+    for (std::size_t pages = 16; pages <= max_pages; pages <<= 1)
+    {
+        const std::size_t bytes = pages * PAGE_SIZE_4K;
+        mapped_buffer small(bytes);
+        mapped_buffer huge(bytes, true);
+        // offset by a line per page, so all pointers do not land in the same cache set
+        auto build = [pages](void* data) {
+            char* base = static_cast<char*>(data);
+            void** first = build_chase(base, pages * PAGE_SIZE_4K, PAGE_SIZE_4K);
+            for (std::size_t i = 0; i < pages; ++i)
+            { // move each node within its page
+                void** node = reinterpret_cast<void**>(base + i * PAGE_SIZE_4K);
+                char* next = static_cast<char*>(*node);
+                const std::size_t next_page = (next - base) / PAGE_SIZE_4K;
+                *reinterpret_cast<void**>(base + i * PAGE_SIZE_4K + (i % 64) * CACHE_LINE_SIZE) =
+                    base + next_page * PAGE_SIZE_4K + (next_page % 64) * CACHE_LINE_SIZE;
+            }
+            const std::size_t first_page = (reinterpret_cast<char*>(first) - base) / PAGE_SIZE_4K;
+            return reinterpret_cast<void**>(base + first_page * PAGE_SIZE_4K + (first_page % 64) * CACHE_LINE_SIZE);
+        };
+        const double ns_small = small.data ? chase(build(small.data), steps) : 0.0;
+        const double ns_huge = huge.data ? chase(build(huge.data), steps) : 0.0;
+        printf("%10zu %10s %14.02f %10.02f (%s)\n", pages, human_bytes(bytes).c_str(), ns_small, ns_huge, huge.kind);
+    }
+}
+//}}}
+
+//{{{ cross core ping pong
+// one-way latency (ns) of handing a cache line from cpu 'a' to cpu 'b' and back
+static inline double ping_pong(int cpu_a, int cpu_b, uint64_t round_trips=PING_PONG_ROUND_TRIPS)
+{
+    // NOTE: no pause in the spin loops, it would add its own latency to the handoff
+    scoped_affinity restore; // we pin ourselves to cpu_a below
+    pin_to_cpu(cpu_a);
+    cache_utils::cache_aligned<std::atomic<uint64_t>> line;
+    std::atomic<bool> ready{false};
+    const uint64_t total = PING_PONG_WARMUP_ROUND_TRIPS + round_trips;
+    std::thread pong([&]() {
+        pin_to_cpu(cpu_b);
+        ready.store(true, std::memory_order_release);
+        for (uint64_t i = 1; i <= total; ++i)
+        {
+            while (line->load(std::memory_order_acquire) != 2*i - 1) {}
+            line->store(2*i, std::memory_order_release);
+        }
+    });
+    while (!ready.load(std::memory_order_acquire)) {}
+
+    // untimed round trips first: both sides spinning, line and code warm
+    uint64_t i = 1;
+    for (; i <= PING_PONG_WARMUP_ROUND_TRIPS; ++i)
+    {
+        line->store(2*i - 1, std::memory_order_release);
+        while (line->load(std::memory_order_acquire) != 2*i) {}
+    }
+    uint64_t begin = rdtsc();
+    for (; i <= total; ++i)
+    {
+        line->store(2*i - 1, std::memory_order_release);
+        while (line->load(std::memory_order_acquire) != 2*i) {}
+    }
+    uint64_t ticks = rdtsc() - begin;
+    pong.join();
+    return get_nanos_from_ticks(ticks) / round_trips / 2;
+}
+
+static inline void core_ping_pong(uint64_t round_trips=PING_PONG_ROUND_TRIPS)
+{
+    const std::vector<int> cpus = available_cpus();
+    if (cpus.size() < 2)
+    {
+        printf("core ping-pong: needs at least 2 allowed cpus, skipped\n");
+        return;
+    }
+    printf("one-way cache line transfer latency (ns), row -> column\n%6s", "cpu");
+    for (int cpu : cpus) printf(" %6d", cpu);
+    printf("\n");
+    for (int a : cpus)
+    {
+        printf("%6d", a);
+        for (int b : cpus)
+        {
+            if (a == b) printf(" %6s", "-");
+            else printf(" %6.01f", ping_pong(a, b, round_trips));
+        }
+        printf("\n");
+    }
+}
+//}}}
+
+static inline void memory_hierarchy_report()
+{
+    print_host_topology();
+    printf("\n== latency (pointer chasing) ==\n");
+    memory_latency();
+    printf("\n== bandwidth ==\n");
+    memory_bandwidth();
+    printf("\n== TLB reach ==\n");
+    tlb_reach();
+    printf("\n== core to core ==\n");
+    core_ping_pong();
+}
+
+} // namespace benchmark
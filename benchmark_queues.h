@@ -0,0 +1,180 @@
+#pragma once
+/* Queue throughput / latency benchmark, on top of benchmarking.h.
+
+   - queue_throughput: producers push MESSAGES uint64_t values (in batches of
+     'batch'), consumers pop them; reports messages per second and ns per
+     message. Every thread is pinned to its own cpu when possible, so a
+     1:1 run measures one core pair.
+   - queue_latency: ping-pong between two threads over two queues; reports
+     the one-way latency (round trip / 2), min and median.
+
+   Example:
+    #include "benchmark_queues.h"
+    int main()
+    {
+        benchmark::queue_benchmark_all();
+    }
+*/
+#include <algorithm>   // std::sort
+#include <atomic>
+#include <memory>      // std::unique_ptr
+#include <thread>
+#include <vector>
+#include "benchmarking.h"
+#include "ring_queue.h"
+
+namespace benchmark {
+
+// How many messages per throughput run / round trips per latency run?
+constexpr uint64_t QUEUE_MESSAGES{10000000ULL};
+constexpr uint64_t QUEUE_ROUND_TRIPS{100000ULL};
+constexpr std::size_t QUEUE_CAPACITY{1024};
+
+// pins thread 'index' of a run to its own cpu (wrapping if we run out)
+static inline void pin_worker(const std::vector<int>& cpus, unsigned index)
+{
+    if (!cpus.empty()) pin_to_cpu(cpus[index % cpus.size()]);
+}
+
+template <typename Queue>
+static inline void queue_throughput(const char* label, unsigned producers=1, unsigned consumers=1,
+                                    uint64_t messages=QUEUE_MESSAGES, std::size_t batch=1)
+{
+    const std::vector<int> cpus = available_cpus();
+    std::unique_ptr<Queue> queue(new Queue());
+    const uint64_t per_producer = messages / producers;
+    const uint64_t total = per_producer * producers;
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> checksum{0};
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> workers;
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        workers.emplace_back([&, p]() {
+            pin_worker(cpus, p);
+            std::vector<uint64_t> items(batch);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) locks::cpu_relax();
+            for (uint64_t i = 0; i < per_producer; )
+            {
+                if (batch == 1)
+                {
+                    queue->push(i++);
+                    continue;
+                }
+                std::size_t n = extrema::min<uint64_t>(batch, per_producer - i);
+                for (std::size_t k = 0; k < n; ++k) items[k] = i + k;
+                std::size_t pushed = 0;
+                while (pushed < n)
+                {
+                    std::size_t done = queue->try_push_n(items.data() + pushed, n - pushed);
+                    if (!done) locks::cpu_relax();
+                    pushed += done;
+                }
+                i += n;
+            }
+        });
+    }
+    for (unsigned c = 0; c < consumers; ++c)
+    {
+        workers.emplace_back([&, c]() {
+            pin_worker(cpus, producers + c);
+            std::vector<uint64_t> items(batch);
+            uint64_t sum{0};
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) locks::cpu_relax();
+            while (consumed.load(std::memory_order_relaxed) < total)
+            {
+                std::size_t n = (batch == 1 ? (queue->try_pop(items[0]) ? 1 : 0)
+                                            : queue->try_pop_n(items.data(), batch));
+                if (!n)
+                {
+                    locks::cpu_relax();
+                    continue;
+                }
+                for (std::size_t k = 0; k < n; ++k) sum += items[k];
+                consumed.fetch_add(n, std::memory_order_relaxed);
+            }
+            checksum.fetch_add(sum);
+        });
+    }
+    while (ready.load() < producers + consumers) locks::cpu_relax();
+
+    uint64_t start = rdtsc();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers) worker.join();
+    uint64_t ticks = rdtsc() - start;
+
+    const uint64_t expected = producers * (per_producer * (per_producer - 1) / 2);
+    const double ns_per_msg = get_nanos_from_ticks(ticks) / total;
+    printf("%8.02f ns per message; %8.02f Mmsgs/s; %17s (%u:%u) batch %3zu%s\n",
+           ns_per_msg, 1e3 / ns_per_msg, label, producers, consumers, batch,
+           (checksum.load() == expected ? "" : " <-- BROKEN: lost or duplicated messages!"));
+}
+
+template <typename Queue>
+static inline void queue_latency(const char* label, uint64_t round_trips=QUEUE_ROUND_TRIPS)
+{
+    const std::vector<int> cpus = available_cpus();
+    scoped_affinity restore; // we pin ourselves below
+    std::unique_ptr<Queue> ping(new Queue());
+    std::unique_ptr<Queue> pong(new Queue());
+    std::atomic<bool> ready{false};
+
+    std::thread echo([&]() {
+        pin_worker(cpus, 1);
+        ready.store(true);
+        uint64_t value;
+        for (uint64_t i = 0; i < round_trips; ++i)
+        {
+            ping->pop(value);
+            pong->push(value);
+        }
+    });
+    pin_worker(cpus, 0);
+    while (!ready.load()) locks::cpu_relax();
+
+    std::vector<uint64_t> samples(round_trips);
+    uint64_t value;
+    for (uint64_t i = 0; i < round_trips; ++i)
+    {
+        uint64_t start = rdtsc();
+        ping->push(i);
+        pong->pop(value);
+        samples[i] = rdtsc() - start;
+    }
+    echo.join();
+
+    std::sort(samples.begin(), samples.end());
+    const uint64_t best = samples.front() > RDTSC_COST ? samples.front() - RDTSC_COST : 0;
+    const uint64_t median = samples[samples.size() / 2] > RDTSC_COST ? samples[samples.size() / 2] - RDTSC_COST : 0;
+    printf("%8.02f ns one-way (min); %8.02f ns one-way (median); %17s\n",
+           get_nanos_from_ticks(best) / 2, get_nanos_from_ticks(median) / 2, label);
+}
+
+static inline void queue_benchmark_all(uint64_t messages=QUEUE_MESSAGES, uint64_t round_trips=QUEUE_ROUND_TRIPS)
+{
+    using spsc = queues::spsc_ring<uint64_t, QUEUE_CAPACITY>;
+    using spsc_futex = queues::spsc_ring<uint64_t, QUEUE_CAPACITY, queues::futex_wait_strategy>;
+    using mpmc = queues::mpmc_queue<uint64_t, QUEUE_CAPACITY>;
+    using mpmc_futex = queues::mpmc_queue<uint64_t, QUEUE_CAPACITY, queues::futex_wait_strategy>;
+
+    for (std::size_t batch : {1, 16, 64})
+    {
+        queue_throughput<spsc>("spsc_ring", 1, 1, messages, batch);
+        queue_throughput<spsc_futex>("spsc_ring(futex)", 1, 1, messages, batch);
+        queue_throughput<mpmc>("mpmc_queue", 1, 1, messages, batch);
+        queue_throughput<mpmc_futex>("mpmc_queue(futex)", 1, 1, messages, batch);
+    }
+    queue_throughput<mpmc>("mpmc_queue", 2, 2, messages, 16);
+    queue_throughput<mpmc_futex>("mpmc_queue(futex)", 2, 2, messages, 16);
+
+    queue_latency<spsc>("spsc_ring", round_trips);
+    queue_latency<spsc_futex>("spsc_ring(futex)", round_trips);
+    queue_latency<mpmc>("mpmc_queue", round_trips);
+    queue_latency<mpmc_futex>("mpmc_queue(futex)", round_trips);
+}
+
+} // namespace benchmark
@@ -11,6 +11,8 @@
     Before running: Make sure that your CPUs are not in scaling mode by running the below:
         sudo cpupower frequency-set --min 2100M --max 2100M
         sudo cpupower frequency-set --governor performance
+    The first benchmark() call checks this (and turbo, SMT siblings, isolcpus, nohz_full,
+    invariant TSC), prints a WARNING for each problem and pins to a cpu; see g_settings.
 
     To find out the speed of your processor and how many cores you have:
         cat /proc/cpuinfo | egrep "(GHz|processor|MHz)" | tr "\n" "\t" | sed 's/processor/\nprocessor/g' | awk 1
@@ -28,6 +30,17 @@
 #include <iomanip>
 #include <csignal>    // sigaction
 #include <cstring>    // memset
+#include <pthread.h>  // pthread_setaffinity_np
+#include <vector>
+#include <algorithm>  // std::sort
+#include <memory>     // std::unique_ptr
+#include <tuple>
+#include <utility>    // std::index_sequence
+#include <cmath>      // std::abs
+#include <cctype>     // std::isdigit
+#include "cpu_features.h" // has_invariant_tsc
+#include "template_utils.h" // void_t
+#include "alloc_tracker.h" // opt-in allocation counting (ALLOC_TRACKER_INTERPOSE)
 
 namespace benchmark {
 
@@ -50,6 +63,10 @@ bool waiting_for_signal{true};
 
 // How many loops to run each test through?
 constexpr uint64_t ITERATIONS{1000000ULL};
+// How many loops to count allocations through (only with ALLOC_TRACKER_INTERPOSE)?
+constexpr uint64_t ALLOC_ITERATIONS{1000ULL};
+// ITERATIONS are also run split in BATCHES, for the median / outlier report
+constexpr uint64_t BATCHES{100ULL};
 
 // ticks are set either by loop or signal initialization above
 static inline double get_nanos_from_ticks(uint64_t ticks)
@@ -62,6 +79,8 @@ static uint64_t RDTSC_COST{};
 static uint64_t CLOCK_GETTIME_COST{};
 
 // Local functions
+// NOTE: only meant for differences inside the benchmark loops (the value is not
+// real nanoseconds since any epoch). For timestamps use clocks::tsc_clock (tsc_clock.h).
 static inline uint64_t get_nsecs(void)
 {
     static struct timespec ts{}; // NOTE: not thread-safe! but decreases 2ns...
@@ -217,6 +236,286 @@ static bool initialized_rdtsc = (calibrate_ticks_with_loop(), true);
 // end - loop initialization
 */
 
+// the main thread's affinity mask at start up (taskset / cgroups), taken
+// pre-main, before prepare_environment() pins the caller to a single cpu
+static inline cpu_set_t startup_affinity()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) != 0) CPU_ZERO(&set);
+    return set;
+}
+static const cpu_set_t g_startup_affinity = startup_affinity();
+
+// Returns the cpus this process may run on (honours taskset / cgroups), even
+// after the calling thread was pinned
+static inline std::vector<int> available_cpus()
+{
+    std::vector<int> cpus;
+    const cpu_set_t set = (CPU_COUNT(&g_startup_affinity) ? g_startup_affinity : startup_affinity());
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// Pins the calling thread to a single cpu; returns false if not allowed
+static inline bool pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+// RAII - restores the calling thread's affinity mask (as it was at construction)
+// on scope exit, for functions that pin the caller only while they measure
+struct scoped_affinity
+{
+    scoped_affinity() { CPU_ZERO(&saved_); valid_ = (::sched_getaffinity(0, sizeof(saved_), &saved_) == 0); }
+    ~scoped_affinity() { if (valid_) ::sched_setaffinity(0, sizeof(saved_), &saved_); }
+
+    private:
+    // not copiable
+    scoped_affinity& operator=(const scoped_affinity &) = delete;
+    scoped_affinity(const scoped_affinity &) = delete;
+    cpu_set_t saved_;
+    bool valid_{false};
+};
+
+// start - environment validation
+/** Everything the header comment asks you to check by hand, checked at run
+    time: scaling governor, turbo, SMT sibling activity, isolcpus/nohz_full,
+    invariant TSC, plus migration between cpus during each benchmark.
+    Problems are printed as WARNINGs (they do not stop the run), so numbers
+    from different hosts can be compared knowing what differed. */
+struct settings
+{
+    bool check_environment{true}; // print the environment report before the first benchmark
+    bool auto_pin{true};          // pin to one cpu (an isolated one, if any) before the first benchmark
+    uint64_t warmup_iterations{ITERATIONS/10}; // calls before any measurement
+    double outlier_threshold{3.5};// median of batch means: drop batches further than this many (scaled) MADs from the median
+};
+static settings g_settings{};
+
+// first line of a sysfs (or procfs) file, without the trailing newline; empty if missing
+static inline std::string read_sysfs(const std::string& path)
+{
+    std::string value;
+    FILE* file = ::fopen(path.c_str(), "r");
+    if (!file) return value;
+    char buf[256];
+    if (::fgets(buf, sizeof(buf), file)) value = buf;
+    ::fclose(file);
+    while (!value.empty() && (value.back() == '\n' || value.back() == ' ')) value.pop_back();
+    return value;
+}
+
+// parses kernel cpu lists, e.g. "0-3,8,10-11"; "(null)" or "" is an empty list
+static inline std::vector<int> parse_cpu_list(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < list.size())
+    {
+        std::size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        const std::string range = list.substr(pos, end - pos);
+        const std::size_t dash = range.find('-');
+        // skips anything that is not a cpu number (e.g. nohz_full reads "(null)" when not set)
+        if (!range.empty() && std::isdigit(static_cast<unsigned char>(range[0])))
+        {
+            const int first = std::atoi(range.c_str());
+            const int last = (dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+static inline bool contains(const std::vector<int>& cpus, int cpu)
+{
+    return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
+
+// busy jiffies of each cpu, from /proc/stat
+static inline std::vector<uint64_t> cpu_busy_jiffies()
+{
+    std::vector<uint64_t> busy;
+    FILE* file = ::fopen("/proc/stat", "r");
+    if (!file) return busy;
+    char line[512];
+    while (::fgets(line, sizeof(line), file))
+    {
+        int cpu{};
+        unsigned long long user{}, nice{}, system{}, idle{}, iowait{}, irq{}, softirq{};
+        if (::sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu", &cpu, &user, &nice, &system, &idle, &iowait, &irq, &softirq) == 8)
+        {
+            if (busy.size() <= (std::size_t)cpu) busy.resize(cpu + 1);
+            busy[cpu] = user + nice + system + irq + softirq;
+        }
+    }
+    ::fclose(file);
+    return busy;
+}
+
+// picks the cpu to run on: the first allowed isolated cpu, else the current one
+static inline int preferred_cpu()
+{
+    const std::vector<int> isolated = parse_cpu_list(read_sysfs("/sys/devices/system/cpu/isolated"));
+    for (int cpu : available_cpus())
+    {
+        if (contains(isolated, cpu)) return cpu;
+    }
+    return sched_getcpu();
+}
+
+// prints the environment of 'cpu'; returns how many warnings were raised
+static inline int report_environment(int cpu)
+{
+    int warnings{0};
+    auto warn = [&warnings](const char* what, const std::string& detail) {
+        printf("WARNING: %s (%s)\n", what, detail.c_str());
+        ++warnings;
+    };
+    const std::string cpu_dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/";
+    printf("environment: cpu %d\n", cpu);
+
+    const std::string governor = read_sysfs(cpu_dir + "cpufreq/scaling_governor");
+    printf("  scaling governor: %s\n", governor.empty() ? "n/a" : governor.c_str());
+    if (!governor.empty() && governor != "performance")
+    {
+        warn("frequency scaling is on, run: sudo cpupower frequency-set --governor performance", governor);
+    }
+
+    const std::string no_turbo = read_sysfs("/sys/devices/system/cpu/intel_pstate/no_turbo");
+    const std::string boost = read_sysfs("/sys/devices/system/cpu/cpufreq/boost");
+    const bool turbo = (no_turbo == "0" || boost == "1");
+    printf("  turbo: %s\n", (no_turbo.empty() && boost.empty()) ? "n/a" : (turbo ? "on" : "off"));
+    if (turbo) warn("turbo is on, frequency depends on temperature and load of other cores", "no_turbo=" + no_turbo + " boost=" + boost);
+
+    const std::vector<int> siblings = parse_cpu_list(read_sysfs(cpu_dir + "topology/thread_siblings_list"));
+    if (siblings.size() > 1)
+    { // sample sibling activity over 100ms
+        const std::vector<uint64_t> before = cpu_busy_jiffies();
+        ::usleep(100000);
+        const std::vector<uint64_t> after = cpu_busy_jiffies();
+        const long hz = ::sysconf(_SC_CLK_TCK);
+        for (int sibling : siblings)
+        {
+            if (sibling == cpu || (std::size_t)sibling >= after.size() || (std::size_t)sibling >= before.size()) continue;
+            const double busy = double(after[sibling] - before[sibling]) / (hz / 10.0);
+            printf("  SMT sibling cpu %d: %.0f%% busy\n", sibling, busy * 100);
+            if (busy > 0.05) warn("SMT sibling is busy, it shares the core's execution units and caches", "cpu " + std::to_string(sibling));
+        }
+    }
+    else
+    {
+        printf("  SMT siblings: none\n");
+    }
+
+    const std::string isolated = read_sysfs("/sys/devices/system/cpu/isolated");
+    const std::string nohz_full = read_sysfs("/sys/devices/system/cpu/nohz_full");
+    printf("  isolcpus: %s; nohz_full: %s\n", isolated.empty() ? "none" : isolated.c_str(), nohz_full.empty() || nohz_full == "(null)" ? "none" : nohz_full.c_str());
+    if (!contains(parse_cpu_list(isolated), cpu)) warn("cpu is not isolated (isolcpus), the scheduler may run other tasks on it", "cpu " + std::to_string(cpu));
+    if (!contains(parse_cpu_list(nohz_full), cpu)) warn("cpu is not nohz_full, the timer tick will interrupt the benchmark", "cpu " + std::to_string(cpu));
+
+    const bool invariant_tsc = cpu_features::has_invariant_tsc();
+    printf("  invariant TSC: %s\n", invariant_tsc ? "yes" : "no");
+    if (!invariant_tsc) warn("no invariant TSC, rdtsc ticks do not map to a constant time unit", "CPUID 80000007H:EDX[8]");
+
+    printf("environment: %d warning(s)\n", warnings);
+    return warnings;
+}
+
+// runs once, before the first measurement: pinning and environment report.
+// NOTE: the calling thread stays pinned; available_cpus() still returns the
+// whole start up mask, so thread benchmarks run afterwards spread as usual
+static inline void prepare_environment()
+{
+    static bool prepared = false;
+    if (prepared) return;
+    prepared = true;
+    int cpu = sched_getcpu();
+    if (g_settings.auto_pin)
+    {
+        cpu = preferred_cpu();
+        if (pin_to_cpu(cpu)) printf("pinned to cpu %d\n", cpu);
+        else printf("WARNING: could not pin to cpu %d\n", cpu);
+    }
+    if (g_settings.check_environment) report_environment(cpu);
+}
+
+static inline void warn_on_migration(const char* label, int cpu_before)
+{
+    const int cpu_after = sched_getcpu();
+    if (cpu_after != cpu_before)
+    {
+        printf("WARNING: %s migrated from cpu %d to cpu %d during the run, results are suspect\n", label, cpu_before, cpu_after);
+    }
+}
+// end - environment validation
+
+// start - sample distributions
+// Summary of per-invocation samples (ticks, RDTSC_COST already deducted)
+struct distribution
+{
+    uint64_t min{};
+    uint64_t p50{};
+    uint64_t p90{};
+    uint64_t p99{};
+    uint64_t max{};
+    std::size_t count{};
+};
+
+// Drops samples further than 'threshold' scaled MADs (median absolute
+// deviation * 1.4826, i.e. ~sigma for normal data) from the median. Unlike
+// mean/stddev based trimming, a few huge outliers (interrupts, page faults)
+// cannot drag the cut-off along. Returns how many were dropped.
+// NOTE: leaves 'samples' sorted
+static inline std::size_t reject_outliers(std::vector<uint64_t>& samples, double threshold)
+{
+    if (samples.size() < 3 || threshold <= 0) return 0;
+    std::sort(samples.begin(), samples.end());
+    const double median = samples[samples.size() / 2];
+    std::vector<double> deviations;
+    deviations.reserve(samples.size());
+    for (uint64_t sample : samples) deviations.push_back(sample > median ? sample - median : median - sample);
+    std::nth_element(deviations.begin(), deviations.begin() + deviations.size() / 2, deviations.end());
+    const double mad = deviations[deviations.size() / 2] * 1.4826;
+    if (mad == 0) return 0; // more than half the samples are identical, nothing to say
+    const std::size_t before = samples.size();
+    samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                 [&](uint64_t sample) { return std::abs(double(sample) - median) > threshold * mad; }),
+                  samples.end());
+    return before - samples.size();
+}
+
+// NOTE: sorts 'samples' in place; no outlier rejection, the tail is what was measured
+static inline distribution summarize(std::vector<uint64_t>& samples)
+{
+    distribution d;
+    if (samples.empty()) return d;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) { return samples[(std::size_t)(q * (samples.size() - 1))]; };
+    d.min = samples.front();
+    d.p50 = at(0.50);
+    d.p90 = at(0.90);
+    d.p99 = at(0.99);
+    d.max = samples.back();
+    d.count = samples.size();
+    return d;
+}
+
+static inline void print_distribution(const char* label, const char* kind, const distribution& d)
+{
+    printf("%17s %5s: min %8lu p50 %8lu p90 %8lu p99 %8lu max %8lu ticks; p50 (%0.2f) ns; %zu samples\n",
+           label, kind, d.min, d.p50, d.p90, d.p99, d.max, get_nanos_from_ticks(d.p50), d.count);
+}
+// end - sample distributions
+
 /** benchmark a function that expects a variable set of arguments in the following format:
 
     #include <cstdarg> // va_list
@@ -230,14 +529,19 @@ static bool initialized_rdtsc = (calibrate_ticks_with_loop(), true);
 template<typename TF, typename ... Args>
 static inline void benchmark(const char* label, TF&& func, Args... args)
 {
+    prepare_environment();
+    // NOTE: args are always passed as lvalues: they are taken by value, so
+    // std::forward would move them out on the first call, and every later call
+    // (and the allocation report) would run on moved-from arguments
+    for (uint64_t i = 0; i < g_settings.warmup_iterations; ++i) func(args...);
     uint16_t cpu = sched_getcpu();
     uint64_t r_best{~0UL}, t_best{~0UL};
 	uint64_t t_start = get_nsecs();
 	// std::forward adds 4 ticks in debug mode...
-    measure_time(r_best, rdtsc(), func(std::forward<Args>(args) ...));
-    measure_time(t_best, get_nsecs(), func(std::forward<Args>(args) ...));
-    //measure_time(r_best, rdtsc(), func(args...));
-    //measure_time(t_best, get_nsecs(), func(args...));
+    //measure_time(r_best, rdtsc(), func(std::forward<Args>(args) ...));
+    //measure_time(t_best, get_nsecs(), func(std::forward<Args>(args) ...));
+    measure_time(r_best, rdtsc(), func(args...));
+    measure_time(t_best, get_nsecs(), func(args...));
 	/**
 	    t_total_delta provided to show what goes into measuring time at start / function / time at end, and even then we are still off by 100ns
 	    Formula is: (((total - (cost*loops))/loops))/2 - 100ns
@@ -252,7 +556,219 @@ static inline void benchmark(const char* label, TF&& func, Args... args)
 	uint64_t r_delta = r_best - RDTSC_COST;
 	uint64_t t_delta = t_best - CLOCK_GETTIME_COST; // NOTE: We are not using t_delta, as it has less definition (it seems to come as a ceil(r_delta))...
 	printf("%8lu ticks; (%0.2f) ns per invocation; %17s on cpu (%02d)\n", r_delta, get_nanos_from_ticks(r_delta), label, cpu);
+    // the best case above hides noise: also report the median of batch means, outliers dropped
+    std::vector<uint64_t> batches(BATCHES);
+    for (uint64_t& batch : batches)
+    {
+        const uint64_t b_start = rdtsc();
+        for (uint64_t i = 0; i < ITERATIONS/BATCHES; ++i) func(args...);
+        batch = (rdtsc() - b_start) / (ITERATIONS/BATCHES);
+    }
+    const distribution d = summarize(batches); // raw tail
+    const std::size_t outliers = reject_outliers(batches, g_settings.outlier_threshold);
+    const uint64_t median = batches[batches.size() / 2];
+    printf("%8lu ticks; (%0.2f) ns median of %zu batch means (%zu outliers dropped; raw p90 %lu max %lu ticks); %17s\n",
+           median, get_nanos_from_ticks(median), batches.size(), outliers, d.p90, d.max, label);
+    warn_on_migration(label, cpu);
+    if (alloc_tracker::interposed())
+    {
+        alloc_tracker::stats allocs = alloc_tracker::measure(ALLOC_ITERATIONS, func, args...);
+        printf("%8.02f allocs; %0.2f bytes; %ld peak live bytes per invocation; %17s\n", allocs.allocations, allocs.bytes_allocated, allocs.peak_live_bytes, label);
+    }
+}
+
+// start - cold cache mode
+/** measure_time() keeps the best of a million back to back calls, i.e. the
+    perfectly warm case. benchmark_cold() instead takes one sample per call
+    and, before each cold sample, evicts the data the call is going to touch:
+      - CLFLUSH:    flushes the arguments (the objects themselves and, for
+                    anything with data()/size(), what they point to)
+      - LLC_STREAM: streams over a buffer twice the size of the last level
+                    cache, evicting everything (including code and page tables)
+    With copies > 1 it rotates over that many copies of the arguments, each on
+    its own page, so consecutive samples also miss the TLB and see different
+    addresses (for distinct *values*, use benchmark_cold_inputs).
+    Warm and cold distributions are printed side by side.
+*/
+enum EvictionType: uint8_t { NONE, CLFLUSH, LLC_STREAM };
+
+// How many samples per (warm or cold) distribution?
+constexpr uint32_t COLD_SAMPLES{1000};
+
+struct cold_options
+{
+    EvictionType eviction{EvictionType::CLFLUSH};
+    uint32_t samples{COLD_SAMPLES};
+    uint32_t copies{1};
+};
+
+static inline void flush_memory(const void* ptr, std::size_t bytes)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    const char* p = static_cast<const char*>(ptr);
+    for (std::size_t offset = 0; offset < bytes; offset += CACHE_LINE_SIZE)
+    {
+        __builtin_ia32_clflush(p + offset);
+    }
+    if (bytes) __builtin_ia32_clflush(p + bytes - 1); // last line, if ptr was not line aligned
+    __builtin_ia32_mfence();
+#else
+    (void)ptr; (void)bytes;
+#endif
+}
+
+// flushes an argument; containers (anything with data() and size()) also
+// get their elements flushed
+template <typename T, typename Enable = void>
+struct cold_flush
+{
+    static inline void flush(const T& value) { flush_memory(&value, sizeof(T)); }
+};
+
+template <typename T>
+struct cold_flush<T, void_t<decltype(std::declval<const T&>().data()), decltype(std::declval<const T&>().size())>>
+{
+    static inline void flush(const T& value)
+    {
+        flush_memory(&value, sizeof(T));
+        flush_memory(value.data(), value.size() * sizeof(*value.data()));
+    }
+};
+
+// a sysfs cache size ("48K", "32M") in bytes, 0 if it does not parse
+static inline std::size_t parse_cache_size(const std::string& value)
+{
+    std::size_t size{0};
+    char unit{'K'};
+    if (::sscanf(value.c_str(), "%zu%c", &size, &unit) < 1) return 0;
+    return size * (unit == 'M' ? 1024*1024 : 1024);
+}
+
+static inline std::size_t llc_size_bytes()
+{
+    std::size_t largest{0};
+    for (int index = 0; index < 8; ++index)
+    {
+        const std::string value = read_sysfs("/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/size");
+        if (value.empty()) break;
+        const std::size_t size = parse_cache_size(value);
+        if (size > largest) largest = size;
+    }
+    return largest ? largest : 64*1024*1024; // a reasonable guess when sysfs is not there
+}
+
+static inline void evict_llc()
+{
+    static std::vector<uint64_t> buffer((2 * llc_size_bytes()) / sizeof(uint64_t));
+    static uint64_t round{0};
+    ++round;
+    for (std::size_t i = 0; i < buffer.size(); i += CACHE_LINE_SIZE / sizeof(uint64_t))
+    {
+        buffer[i] += round; // read and write every line, so it owns the line exclusively
+    }
+    asm volatile("" ::: "memory");
+}
+
+template <typename Tuple, std::size_t ... I>
+static inline void flush_arguments(const Tuple& args, std::index_sequence<I...>)
+{
+    int expand[] = {0, (cold_flush<typename std::decay<decltype(std::get<I>(args))>::type>::flush(std::get<I>(args)), 0)...};
+    (void)expand;
+    flush_memory(&args, sizeof(Tuple));
+}
+
+template <typename TF, typename Tuple, std::size_t ... I>
+static inline uint64_t sample_once(TF& func, Tuple& args, std::index_sequence<I...>)
+{
+    uint64_t start = rdtsc();
+    func(std::get<I>(args)...);
+    uint64_t delta = rdtsc() - start;
+    return delta > RDTSC_COST ? delta - RDTSC_COST : 0;
+}
+
+// runs the warm and cold samples over 'inputs' (pointers to argument tuples)
+template<typename TF, typename Tuple>
+static inline void cold_run(const char* label, const cold_options& options, TF& func, const std::vector<Tuple*>& inputs)
+{
+    using indices = std::make_index_sequence<std::tuple_size<Tuple>::value>;
+    prepare_environment();
+    const int cpu = sched_getcpu();
+    std::vector<uint64_t> warm, cold;
+    warm.reserve(options.samples);
+    cold.reserve(options.samples);
+
+    sample_once(func, *inputs[0], indices{}); // touch it once
+    for (uint32_t i = 0; i < options.samples; ++i)
+    { // warm: same input over and over
+        warm.push_back(sample_once(func, *inputs[0], indices{}));
+    }
+    for (uint32_t i = 0; i < options.samples; ++i)
+    {
+        Tuple& args = *inputs[i % inputs.size()];
+        switch (options.eviction)
+        {
+            case EvictionType::CLFLUSH: flush_arguments(args, indices{}); break;
+            case EvictionType::LLC_STREAM: evict_llc(); break;
+            case EvictionType::NONE: break;
+        }
+        cold.push_back(sample_once(func, args, indices{}));
+    }
+
+    warn_on_migration(label, cpu);
+    const distribution w = summarize(warm);
+    const distribution c = summarize(cold);
+    print_distribution(label, "warm", w);
+    print_distribution(label, "cold", c);
+    printf("%17s cold/warm p50: %0.2fx (eviction: %s, inputs: %zu)\n", label,
+           w.p50 ? double(c.p50) / w.p50 : 0.0,
+           (options.eviction == EvictionType::CLFLUSH ? "clflush" : options.eviction == EvictionType::LLC_STREAM ? "llc stream" : "none"),
+           inputs.size());
+}
+
+// page spaced copies of a value: each on its own page(s), at a different
+// line offset, so they also land in different cache sets
+template <typename T>
+struct page_spaced_copies
+{
+    static constexpr std::size_t PAGE{4096};
+    static constexpr std::size_t STRIDE{((sizeof(T) + PAGE + PAGE - 1) / PAGE) * PAGE};
+
+    page_spaced_copies(const T& value, std::size_t count) : memory_(new char[STRIDE * count + PAGE])
+    {
+        char* base = memory_.get() + (PAGE - ((uintptr_t)memory_.get() % PAGE)) % PAGE;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            copies.push_back(new (base + i * STRIDE + (i % (PAGE / CACHE_LINE_SIZE)) * CACHE_LINE_SIZE) T(value));
+        }
+    }
+    ~page_spaced_copies() { for (T* copy : copies) copy->~T(); }
+
+    std::vector<T*> copies;
+
+private:
+    std::unique_ptr<char[]> memory_;
+};
+
+/** benchmark func cold and warm, rotating over 'inputs' (one tuple of
+    arguments per distinct input, e.g. different messages to parse, which
+    also keeps the branch predictor from learning a single input) */
+template<typename TF, typename ... Args>
+static inline void benchmark_cold_inputs(const char* label, const cold_options& options, TF&& func, std::vector<std::tuple<Args...>>& inputs)
+{
+    if (inputs.empty()) return;
+    std::vector<std::tuple<Args...>*> pointers;
+    for (auto& input : inputs) pointers.push_back(&input);
+    cold_run(label, options, func, pointers);
+}
+
+/** benchmark func cold and warm with (options.copies copies of) the given arguments */
+template<typename TF, typename ... Args>
+static inline void benchmark_cold(const char* label, const cold_options& options, TF&& func, Args... args)
+{
+    page_spaced_copies<std::tuple<Args...>> inputs(std::tuple<Args...>(args...), options.copies ? options.copies : 1);
+    cold_run(label, options, func, inputs.copies);
 }
+// end - cold cache mode
 
 } // namespace benchmark
 
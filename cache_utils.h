@@ -0,0 +1,143 @@
+#pragma once
+/* Cache line aware wrappers and counters, to avoid false sharing between cores.
+
+   - cache_aligned<T>: T starts on its own cache line, and sizeof is rounded up
+     to a multiple of the line size (so arrays of them never share lines).
+   - padded<T>: same guarantee WITHOUT over-alignment, by surrounding T with
+     padding. Use it where alignas is not honoured (placement in raw/shared
+     memory, pre-C++17 allocators, packed structures).
+   - sharded_counter: one counter per CPU, written with relaxed atomics on the
+     local shard only, and merged (summed) on read. Writers never bounce the
+     same cache line between cores; reads are O(SHARDS), so keep them off
+     the hot path.
+
+   Example:
+    static cache_utils::sharded_counter<> g_messages;
+    ++g_messages;                  // hot path, local cache line only
+    uint64_t total = g_messages.load(); // stats thread, merges all shards
+*/
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <sched.h>       // sched_getcpu
+#include <type_traits>
+#include <utility>       // std::forward
+#include "template_utils.h"
+
+namespace cache_utils {
+
+//{{{ cache_aligned
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) cache_aligned
+{
+    cache_aligned() = default;
+
+    template <typename... Args,
+              typename = typename std::enable_if<(sizeof...(Args) > 0) &&
+                                                 std::is_constructible<T, Args&&...>::value>::type>
+    explicit cache_aligned(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    T& operator*() { return value; }
+    const T& operator*() const { return value; }
+    T* operator->() { return &value; }
+    const T* operator->() const { return &value; }
+
+    T value{};
+};
+//}}}
+
+//{{{ padded
+template <typename T, std::size_t LINE=CACHE_LINE_SIZE>
+struct padded
+{
+    padded() = default;
+
+    template <typename... Args,
+              typename = typename std::enable_if<(sizeof...(Args) > 0) &&
+                                                 std::is_constructible<T, Args&&...>::value>::type>
+    explicit padded(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    T& operator*() { return value; }
+    const T& operator*() const { return value; }
+    T* operator->() { return &value; }
+    const T* operator->() const { return &value; }
+
+private:
+    // a full line in front: whatever precedes us ends before value's first line
+    char pad_front_[LINE];
+public:
+    T value{};
+private:
+    // and a full line past the end: whatever follows starts after value's last line
+    char pad_back_[LINE];
+};
+//}}}
+
+//{{{ sharded_counter
+// Returns the cpu the calling thread runs on. sched_getcpu goes through the
+// vDSO (or rseq on newer glibc), so it costs a few ns. If the thread migrates
+// right after the call we just write to a 'remote' shard: still correct
+// (atomic), only slower for that one increment.
+static inline unsigned current_cpu()
+{
+    int cpu = ::sched_getcpu();
+    return cpu < 0 ? 0U : static_cast<unsigned>(cpu);
+}
+
+template <std::size_t SHARDS=64, typename T=uint64_t>
+class sharded_counter
+{
+    static_assert(SHARDS > 0, "sharded_counter needs at least one shard");
+    static_assert(std::is_integral<T>::value, "sharded_counter only supports integral types");
+
+public:
+    sharded_counter() = default;
+
+    inline void add(T delta)
+    {
+        shards_[current_cpu() % SHARDS]->fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    inline sharded_counter& operator++() { add(1); return *this; }
+    inline sharded_counter& operator+=(T delta) { add(delta); return *this; }
+
+    // merges all shards; the result is not a snapshot across shards, as
+    // writers may keep updating while we sum
+    inline T load() const
+    {
+        T total{};
+        for (const auto& shard : shards_)
+        {
+            total += shard->load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    inline operator T() const { return load(); }
+
+    inline void reset()
+    {
+        for (auto& shard : shards_)
+        {
+            shard->store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr std::size_t shards() { return SHARDS; }
+
+private:
+    // not copiable
+    sharded_counter(const sharded_counter&) = delete;
+    sharded_counter& operator=(const sharded_counter&) = delete;
+
+    cache_aligned<std::atomic<T>> shards_[SHARDS];
+};
+//}}}
+
+// make sure the wrappers do what they promise
+static_assert(is_cache_line_size_aligned<cache_aligned<char>>::VALUE, "cache_aligned<char> is not line sized");
+static_assert(alignof(cache_aligned<char>) == CACHE_LINE_SIZE, "cache_aligned<char> is not line aligned");
+static_assert(sizeof(padded<char>) == 2*CACHE_LINE_SIZE + 1, "padded<char> has unexpected size");
+static_assert(sizeof(padded<char[CACHE_LINE_SIZE]>) == 3*CACHE_LINE_SIZE, "padded<char[64]> has unexpected size");
+
+} // namespace cache_utils
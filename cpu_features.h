@@ -0,0 +1,28 @@
+#pragma once
+/* CPU feature checks shared by benchmarking.h and tsc_clock.h.
+
+   Kept free of any other include from this repo: tsc_clock.h cannot pull in
+   benchmarking.h (it calibrates rdtsc before main).
+
+   Example:
+    if (!cpu_features::has_invariant_tsc()) puts("rdtsc ticks are not a constant time unit");
+*/
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>    // __get_cpuid
+#endif
+
+namespace cpu_features {
+
+// CPUID.80000007H:EDX[8]; always false on non-x86
+static inline bool has_invariant_tsc() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax{}, ebx{}, ecx{}, edx{};
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+    return edx & (1U << 8);
+#else
+    return false;
+#endif
+}
+
+} // namespace cpu_features
@@ -0,0 +1,167 @@
+#pragma once
+/* Fixed capacity string, stored inline (no heap pointer).
+
+   FixedString<N> holds up to N chars plus a null terminator, and its length
+   in the smallest unsigned type that fits N. It is trivially copyable, so
+   structures holding it can be copied with memcpy (or sent as is), and
+   most of it is constexpr.
+
+   When an operation does not fit, POLICY decides:
+    - overflow_policy::truncate:     keep what fits (append returns false)
+    - overflow_policy::debug_assert: assert() in debug builds (and at compile
+                                     time in constexpr contexts), then truncate
+
+   Example:
+    struct Order { FixedString<8> symbol; FixedString<16> id; double price; };
+    constexpr FixedString<8> symbol("AAPL");
+    Order order{symbol, {}, 1.0};
+    order.id.format("%08u", 42U);
+    std::string_view view = order.id;
+*/
+#if __cplusplus < 201703L
+#error "fixed_string.h needs C++17 (constexpr / std::string_view)"
+#endif
+#include <cassert>
+#include <cstdarg>     // va_list
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>      // vsnprintf
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace string_utils {
+
+enum class overflow_policy : uint8_t { truncate, debug_assert };
+
+template <std::size_t N, overflow_policy POLICY=overflow_policy::truncate>
+class FixedString
+{
+    static_assert(N > 0, "FixedString needs a capacity");
+
+public:
+    // smallest type that can hold N
+    using size_type = std::conditional_t<(N <= UINT8_MAX), uint8_t,
+                      std::conditional_t<(N <= UINT16_MAX), uint16_t, uint32_t>>;
+
+    constexpr FixedString() = default;
+    constexpr FixedString(const char* str) { append(std::string_view(str)); }
+    constexpr FixedString(std::string_view str) { append(str); }
+    template <std::size_t M, overflow_policy P>
+    constexpr FixedString(const FixedString<M, P>& other) { append(other.view()); }
+
+    //{{{ capacity / access
+    static constexpr std::size_t capacity() { return N; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr std::size_t length() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr std::size_t remaining() const { return N - size_; }
+
+    constexpr const char* data() const { return data_; }
+    constexpr char* data() { return data_; }
+    constexpr const char* c_str() const { return data_; }
+    constexpr const char* begin() const { return data_; }
+    constexpr const char* end() const { return data_ + size_; }
+
+    // like std::string, [size()] is the null terminator
+    constexpr char operator[](std::size_t pos) const { return data_[pos]; }
+    constexpr char& operator[](std::size_t pos) { return data_[pos]; }
+
+    constexpr std::string_view view() const { return std::string_view(data_, size_); }
+    constexpr operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(data_, size_); }
+    //}}}
+
+    //{{{ modifiers
+    // all of them return false (after applying the overflow policy) if the
+    // result did not fit
+    constexpr void clear() { size_ = 0; data_[0] = 0; }
+
+    constexpr bool append(std::string_view str)
+    {
+        const std::size_t count = fit(str.size());
+        for (std::size_t i = 0; i < count; ++i) data_[size_ + i] = str[i];
+        return grow(count, str.size());
+    }
+
+    constexpr bool append(std::size_t count, char c)
+    {
+        const std::size_t fits = fit(count);
+        for (std::size_t i = 0; i < fits; ++i) data_[size_ + i] = c;
+        return grow(fits, count);
+    }
+
+    constexpr bool push_back(char c) { return append(1, c); }
+    constexpr FixedString& operator+=(std::string_view str) { append(str); return *this; }
+    constexpr FixedString& operator+=(char c) { append(1, c); return *this; }
+
+    // inserts 'count' copies of 'c' at 'pos'; chars pushed past N are dropped
+    constexpr bool insert(std::size_t pos, std::size_t count, char c)
+    {
+        if (pos > size_) pos = size_;
+        const std::size_t inserted = (count < N - pos ? count : N - pos);
+        const std::size_t kept = (size_ - pos < N - pos - inserted ? size_ - pos : N - pos - inserted);
+        for (std::size_t i = kept; i > 0; --i) data_[pos + inserted + i - 1] = data_[pos + i - 1];
+        for (std::size_t i = 0; i < inserted; ++i) data_[pos + i] = c;
+        const std::size_t wanted = size_ + count;
+        size_ = static_cast<size_type>(pos + inserted + kept);
+        data_[size_] = 0;
+        if (wanted > N) return overflow();
+        return true;
+    }
+
+    constexpr FixedString& erase(std::size_t pos=0, std::size_t count=std::string_view::npos)
+    {
+        if (pos >= size_) return *this;
+        if (count > size_ - pos) count = size_ - pos;
+        for (std::size_t i = pos + count; i <= size_; ++i) data_[i - count] = data_[i]; // includes the terminator
+        size_ = static_cast<size_type>(size_ - count);
+        return *this;
+    }
+
+    // printf-style append
+    bool format(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, fmt);
+        const int written = ::vsnprintf(data_ + size_, N - size_ + 1, fmt, args);
+        va_end(args);
+        if (written < 0) { data_[size_] = 0; return false; }
+        return grow(fit(written), written);
+    }
+    //}}}
+
+    constexpr bool operator==(std::string_view other) const { return view() == other; }
+    constexpr bool operator!=(std::string_view other) const { return view() != other; }
+    constexpr bool operator<(std::string_view other) const { return view() < other; }
+
+private:
+    constexpr std::size_t fit(std::size_t count) const { return count < N - size_ ? count : N - size_; }
+
+    // accounts for 'added' chars (out of 'wanted') already written past size_
+    constexpr bool grow(std::size_t added, std::size_t wanted)
+    {
+        size_ = static_cast<size_type>(size_ + added);
+        data_[size_] = 0;
+        if (added != wanted) return overflow();
+        return true;
+    }
+
+    constexpr bool overflow() const
+    {
+        if constexpr (POLICY == overflow_policy::debug_assert)
+        {
+            assert(!"FixedString overflow");
+        }
+        return false;
+    }
+
+    size_type size_{0};
+    char data_[N + 1]{};
+};
+
+// make sure it can be copied with memcpy
+static_assert(std::is_trivially_copyable<FixedString<15>>::value, "FixedString is not trivially copyable");
+static_assert(sizeof(FixedString<15>) == 17, "FixedString<15> has unexpected size");
+
+} // namespace string_utils
@@ -0,0 +1,326 @@
+#pragma once
+/* Lightweight locks for very short critical sections.
+
+   All locks are usable through locks::lock_guard<Lock> (RAII):
+    - spin_lock:      test-and-test-and-set with pause and exponential backoff.
+                      Cheapest when uncontended, unfair under contention.
+    - ticket_lock:    FIFO fair. Every waiter spins on the same line, so it
+                      degrades with many cores, but nobody starves.
+    - mcs_lock:       FIFO fair queue lock; every waiter spins on its OWN node,
+                      so handoff only touches the next waiter's cache line.
+                      The node lives in the guard (on the stack).
+    - adaptive_mutex: spins for a bounded time, then sleeps on a futex. Use it
+                      when the critical section is usually short but may
+                      occasionally be long (or when threads > cores).
+    - pthread_mutex_t is accepted by lock_guard as well.
+
+   Example:
+    locks::ticket_lock lock;
+    {
+        locks::lock_guard<locks::ticket_lock> guard(lock);
+        ... critical section ...
+    }
+
+   NOTE: spinning locks assume threads <= available cores. If a lock holder is
+   preempted, all spinners burn their quantum; prefer adaptive_mutex then.
+*/
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <unistd.h>      // syscall
+#include <sys/syscall.h> // SYS_futex
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE
+#include "template_utils.h"
+
+namespace locks {
+
+//{{{ cpu relax / backoff
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    asm volatile("" ::: "memory");
+#endif
+}
+
+// exponential backoff, capped so a waiter notices a released lock quickly
+template <uint32_t MAX_SPINS=64>
+struct backoff
+{
+    inline void pause()
+    {
+        for (uint32_t i = 0; i < spins_; ++i) cpu_relax();
+        if (spins_ < MAX_SPINS) spins_ <<= 1;
+    }
+    inline void reset() { spins_ = 1; }
+
+private:
+    uint32_t spins_{1};
+};
+//}}}
+
+//{{{ futex
+static inline long futex_wait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static inline long futex_wake(std::atomic<uint32_t>& word, int count=1)
+{
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+//}}}
+
+//{{{ spin_lock (test-and-test-and-set)
+class spin_lock
+{
+public:
+    spin_lock() = default;
+
+    inline void lock()
+    {
+        backoff<> wait;
+        while (locked_.exchange(true, std::memory_order_acquire))
+        {
+            // spin on a plain load: the line stays shared in our cache until
+            // the owner writes it, instead of bouncing it around with RMWs
+            while (locked_.load(std::memory_order_relaxed)) wait.pause();
+        }
+    }
+
+    inline bool try_lock()
+    {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    inline void unlock() { locked_.store(false, std::memory_order_release); }
+
+private:
+    // not copiable
+    spin_lock(const spin_lock&) = delete;
+    spin_lock& operator=(const spin_lock&) = delete;
+
+    std::atomic<bool> locked_{false};
+};
+//}}}
+
+//{{{ ticket_lock
+class ticket_lock
+{
+public:
+    ticket_lock() = default;
+
+    inline void lock()
+    {
+        const uint32_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        for (;;)
+        {
+            const uint32_t serving = serving_.load(std::memory_order_acquire);
+            if (serving == ticket) return;
+            // proportional backoff: the further back in line, the longer we wait
+            for (uint32_t i = (ticket - serving) * 32; i > 0; --i) cpu_relax();
+        }
+    }
+
+    inline bool try_lock()
+    {
+        uint32_t serving = serving_.load(std::memory_order_acquire);
+        uint32_t expected = serving;
+        return next_.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock()
+    {
+        // only the owner writes serving_, so load+store is enough (no RMW)
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    // not copiable
+    ticket_lock(const ticket_lock&) = delete;
+    ticket_lock& operator=(const ticket_lock&) = delete;
+
+    std::atomic<uint32_t> next_{0};
+    std::atomic<uint32_t> serving_{0};
+};
+//}}}
+
+//{{{ mcs_lock
+class mcs_lock
+{
+public:
+    // one node per acquisition; it must stay alive (and in place) until unlock
+    struct alignas(CACHE_LINE_SIZE) node
+    {
+        std::atomic<node*> next{nullptr};
+        std::atomic<bool> locked{false};
+    };
+
+    mcs_lock() = default;
+
+    inline void lock(node& me)
+    {
+        me.next.store(nullptr, std::memory_order_relaxed);
+        me.locked.store(true, std::memory_order_relaxed);
+        node* prev = tail_.exchange(&me, std::memory_order_acq_rel);
+        if (prev)
+        {
+            prev->next.store(&me, std::memory_order_release);
+            while (me.locked.load(std::memory_order_acquire)) cpu_relax();
+        }
+    }
+
+    inline bool try_lock(node& me)
+    {
+        me.next.store(nullptr, std::memory_order_relaxed);
+        node* expected = nullptr;
+        return tail_.compare_exchange_strong(expected, &me, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock(node& me)
+    {
+        node* next = me.next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            node* expected = &me;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return; // nobody waiting
+            }
+            // a successor swapped the tail but has not linked itself yet
+            while (!(next = me.next.load(std::memory_order_acquire))) cpu_relax();
+        }
+        next->locked.store(false, std::memory_order_release);
+    }
+
+private:
+    // not copiable
+    mcs_lock(const mcs_lock&) = delete;
+    mcs_lock& operator=(const mcs_lock&) = delete;
+
+    std::atomic<node*> tail_{nullptr};
+};
+//}}}
+
+//{{{ adaptive_mutex (spin, then futex)
+// States as in Drepper's "Futexes Are Tricky" (mutex3):
+//  0: unlocked, 1: locked, 2: locked and (maybe) someone sleeping on the futex
+template <uint32_t SPIN_LIMIT=128>
+class basic_adaptive_mutex
+{
+public:
+    basic_adaptive_mutex() = default;
+
+    inline void lock()
+    {
+        uint32_t state = UNLOCKED;
+        if (state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return; // fast path, uncontended
+        }
+
+        backoff<> wait;
+        for (uint32_t spin = 0; spin < SPIN_LIMIT; ++spin)
+        {
+            wait.pause();
+            state = UNLOCKED;
+            if (state_.load(std::memory_order_relaxed) == UNLOCKED &&
+                state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+
+        // slow path: mark as contended and sleep until woken up
+        if (state != CONTENDED) state = state_.exchange(CONTENDED, std::memory_order_acquire);
+        while (state != UNLOCKED)
+        {
+            futex_wait(state_, CONTENDED);
+            state = state_.exchange(CONTENDED, std::memory_order_acquire);
+        }
+    }
+
+    inline bool try_lock()
+    {
+        uint32_t state = UNLOCKED;
+        return state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock()
+    {
+        if (state_.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+        {
+            futex_wake(state_, 1);
+        }
+    }
+
+private:
+    // not copiable
+    basic_adaptive_mutex(const basic_adaptive_mutex&) = delete;
+    basic_adaptive_mutex& operator=(const basic_adaptive_mutex&) = delete;
+
+    enum : uint32_t { UNLOCKED = 0, LOCKED = 1, CONTENDED = 2 };
+    std::atomic<uint32_t> state_{UNLOCKED};
+};
+using adaptive_mutex = basic_adaptive_mutex<>;
+//}}}
+
+//{{{ RAII-Guard
+// lock_context adapts each lock to a uniform lock(ctx)/unlock(ctx) interface,
+// where ctx is whatever per-acquisition state the lock needs (MCS node), or
+// an empty struct for everything else.
+struct no_context {};
+
+template <typename Mutex, typename Enable = void>
+struct lock_context
+{
+    using type = no_context;
+    static inline void lock(Mutex& mutex, type&) { mutex.lock(); }
+    static inline void unlock(Mutex& mutex, type&) { mutex.unlock(); }
+};
+
+// queue locks, which expose a nested 'node' type
+template <typename Mutex>
+struct lock_context<Mutex, void_t<typename Mutex::node>>
+{
+    using type = typename Mutex::node;
+    static inline void lock(Mutex& mutex, type& node) { mutex.lock(node); }
+    static inline void unlock(Mutex& mutex, type& node) { mutex.unlock(node); }
+};
+
+template <>
+struct lock_context<pthread_mutex_t>
+{
+    using type = no_context;
+    static inline void lock(pthread_mutex_t& mutex, type&) { ::pthread_mutex_lock(&mutex); }
+    static inline void unlock(pthread_mutex_t& mutex, type&) { ::pthread_mutex_unlock(&mutex); }
+};
+
+template <typename Mutex>
+struct lock_guard
+{
+    explicit lock_guard(Mutex &mutex) : mutex_(mutex)
+    {
+        lock_context<Mutex>::lock(mutex_, context_);
+    }
+    ~lock_guard()
+    {
+        lock_context<Mutex>::unlock(mutex_, context_);
+    }
+
+    private:
+    // not copiable
+    lock_guard& operator=(const lock_guard &) = delete;
+    lock_guard(const lock_guard &) = delete;
+    lock_guard() = delete;
+    Mutex & mutex_;
+    typename lock_context<Mutex>::type context_;
+};
+//}}}
+
+} // namespace locks
@@ -0,0 +1,464 @@
+#pragma once
+/* Bounded lock-free queues for handing data between threads.
+
+   - spsc_ring<T, CAPACITY>: one producer thread, one consumer thread.
+     Head and tail live on their own cache lines, and each side keeps a
+     cached copy of the other side's index, so it only touches the shared
+     line when its cached view says the ring is full/empty.
+   - mpmc_queue<T, CAPACITY>: any number of producers and consumers, after
+     Dmitry Vyukov's bounded MPMC queue (one sequence number per cell). Batch
+     operations claim several cells with a single CAS.
+
+   CAPACITY must be a power of two (index wrap is a mask, not a modulo).
+
+   try_* calls never block. push/pop block using the WAIT strategy:
+    - spin_wait:           busy spin with pause (lowest latency, burns a core)
+    - futex_wait_strategy: spin for a while, then sleep on a futex. Every
+                           push and pop pays a seq_cst fence (mfence on x86,
+                           tens of cycles) plus a load of the sleepers count,
+                           even when nobody sleeps; measure it against
+                           spin_wait (queue_benchmark_all) before choosing it.
+
+   Example:
+    queues::spsc_ring<Message, 1024> ring;
+    // producer thread                // consumer thread
+    ring.push(msg);                   Message msg; ring.pop(msg);
+*/
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>      // std::unique_ptr
+#include <new>         // placement new
+#include <type_traits>
+#include <utility>     // std::move
+#include "cache_utils.h"
+#include "locks.h"     // cpu_relax, futex_wait, futex_wake
+
+namespace queues {
+
+//{{{ wait strategies
+// A strategy is used once per condition ('not empty', 'not full'):
+//   wait(ready): returns once ready() is true
+//   notify():    called after the condition may have become true
+struct spin_wait
+{
+    template <typename Ready>
+    inline void wait(Ready&& ready)
+    {
+        while (!ready()) locks::cpu_relax();
+    }
+    inline void notify() {}
+};
+
+template <uint32_t SPIN_LIMIT=1024>
+struct basic_futex_wait_strategy
+{
+    template <typename Ready>
+    inline void wait(Ready&& ready)
+    {
+        for (uint32_t spin = 0; spin < SPIN_LIMIT; ++spin)
+        {
+            if (ready()) return;
+            locks::cpu_relax();
+        }
+        for (;;)
+        {
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const uint32_t seq = seq_.load(std::memory_order_seq_cst);
+            // re-check after announcing ourselves, or we could miss the notify
+            if (ready())
+            {
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            locks::futex_wait(seq_, seq);
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            if (ready()) return;
+        }
+    }
+
+    inline void notify()
+    {
+        // pairs with the fence in wait(): either the waiter sees
+        // our update in ready(), or we see it in sleepers_.
+        // NOTE: unconditional, on every push/pop (mfence on x86)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed))
+        {
+            seq_.fetch_add(1, std::memory_order_release);
+            locks::futex_wake(seq_, INT32_MAX);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+using futex_wait_strategy = basic_futex_wait_strategy<>;
+//}}}
+
+//{{{ spsc_ring
+template <typename T, std::size_t CAPACITY, typename WAIT=spin_wait>
+class spsc_ring
+{
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+    static constexpr std::size_t MASK = CAPACITY - 1;
+    using storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+public:
+    spsc_ring() : slots_(new storage[CAPACITY]) {}
+
+    ~spsc_ring()
+    {
+        const std::size_t head = producer_->head.load(std::memory_order_acquire);
+        for (std::size_t tail = tail_->load(std::memory_order_relaxed); tail != head; ++tail)
+        {
+            reinterpret_cast<T*>(&slots_[tail & MASK])->~T();
+        }
+    }
+
+    //{{{ producer side
+    template <typename U>
+    inline bool try_push(U&& item)
+    {
+        const std::size_t head = producer_->head.load(std::memory_order_relaxed);
+        if (head - producer_->cached_tail == CAPACITY)
+        {
+            producer_->cached_tail = tail_->load(std::memory_order_acquire);
+            if (head - producer_->cached_tail == CAPACITY) return false; // full
+        }
+        new (&slots_[head & MASK]) T(std::forward<U>(item));
+        producer_->head.store(head + 1, std::memory_order_release);
+        not_empty_->notify();
+        return true;
+    }
+
+    // pushes up to 'count' items, publishing them all with a single store.
+    // Returns how many were pushed.
+    inline std::size_t try_push_n(const T* items, std::size_t count)
+    {
+        const std::size_t head = producer_->head.load(std::memory_order_relaxed);
+        std::size_t free_slots = CAPACITY - (head - producer_->cached_tail);
+        if (free_slots < count)
+        {
+            producer_->cached_tail = tail_->load(std::memory_order_acquire);
+            free_slots = CAPACITY - (head - producer_->cached_tail);
+        }
+        const std::size_t n = extrema::min(free_slots, count);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            new (&slots_[(head + i) & MASK]) T(items[i]);
+        }
+        if (n)
+        {
+            producer_->head.store(head + n, std::memory_order_release);
+            not_empty_->notify();
+        }
+        return n;
+    }
+
+    template <typename U>
+    inline void push(U&& item)
+    {
+        while (!try_push(std::forward<U>(item)))
+        {
+            not_full_->wait([this]() { return !full(); });
+        }
+    }
+    //}}}
+
+    //{{{ consumer side
+    inline bool try_pop(T& item)
+    {
+        const std::size_t tail = tail_->load(std::memory_order_relaxed);
+        if (consumer_->cached_head == tail)
+        {
+            consumer_->cached_head = producer_->head.load(std::memory_order_acquire);
+            if (consumer_->cached_head == tail) return false; // empty
+        }
+        T* slot = reinterpret_cast<T*>(&slots_[tail & MASK]);
+        item = std::move(*slot);
+        slot->~T();
+        tail_->store(tail + 1, std::memory_order_release);
+        not_full_->notify();
+        return true;
+    }
+
+    // pops up to 'count' items, releasing their slots with a single store.
+    // Returns how many were popped.
+    inline std::size_t try_pop_n(T* items, std::size_t count)
+    {
+        const std::size_t tail = tail_->load(std::memory_order_relaxed);
+        std::size_t available = consumer_->cached_head - tail;
+        if (available < count)
+        {
+            consumer_->cached_head = producer_->head.load(std::memory_order_acquire);
+            available = consumer_->cached_head - tail;
+        }
+        const std::size_t n = extrema::min(available, count);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            T* slot = reinterpret_cast<T*>(&slots_[(tail + i) & MASK]);
+            items[i] = std::move(*slot);
+            slot->~T();
+        }
+        if (n)
+        {
+            tail_->store(tail + n, std::memory_order_release);
+            not_full_->notify();
+        }
+        return n;
+    }
+
+    inline void pop(T& item)
+    {
+        while (!try_pop(item))
+        {
+            not_empty_->wait([this]() { return !empty(); });
+        }
+    }
+    //}}}
+
+    // approximate when called while the other side is running
+    inline bool empty() const { return producer_->head.load(std::memory_order_acquire) == tail_->load(std::memory_order_acquire); }
+    inline bool full() const { return size() >= CAPACITY; }
+    inline std::size_t size() const { return producer_->head.load(std::memory_order_acquire) - tail_->load(std::memory_order_acquire); }
+    static constexpr std::size_t capacity() { return CAPACITY; }
+
+private:
+    // not copiable
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // written by the producer only (cached_tail is its private view of tail_)
+    struct producer_state
+    {
+        std::atomic<std::size_t> head{0};
+        std::size_t cached_tail{0};
+    };
+    // written by the consumer only
+    struct consumer_state
+    {
+        std::size_t cached_head{0};
+    };
+
+    cache_utils::cache_aligned<producer_state> producer_;
+    cache_utils::cache_aligned<std::atomic<std::size_t>> tail_;
+    cache_utils::cache_aligned<consumer_state> consumer_;
+    cache_utils::cache_aligned<WAIT> not_empty_;
+    cache_utils::cache_aligned<WAIT> not_full_;
+    std::unique_ptr<storage[]> slots_;
+};
+//}}}
+
+//{{{ mpmc_queue
+template <typename T, std::size_t CAPACITY, typename WAIT=spin_wait>
+class mpmc_queue
+{
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+    static constexpr std::size_t MASK = CAPACITY - 1;
+
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+        inline T* get() { return reinterpret_cast<T*>(&data); }
+    };
+
+public:
+    mpmc_queue() : cells_(new cell[CAPACITY])
+    {
+        for (std::size_t i = 0; i < CAPACITY; ++i)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_queue()
+    {
+        // no one else may be using the queue by now: every cell between the
+        // two positions holds a published item
+        const std::size_t enq = enqueue_pos_->load(std::memory_order_acquire);
+        for (std::size_t pos = dequeue_pos_->load(std::memory_order_relaxed); pos != enq; ++pos)
+        {
+            cells_[pos & MASK].get()->~T();
+        }
+    }
+
+    //{{{ producers
+    template <typename U>
+    inline bool try_push(U&& item)
+    {
+        cell* target;
+        std::size_t pos = enqueue_pos_->load(std::memory_order_relaxed);
+        for (;;)
+        {
+            target = &cells_[pos & MASK];
+            const std::size_t seq = target->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueue_pos_->compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_->load(std::memory_order_relaxed); // someone else got it
+            }
+        }
+        new (target->get()) T(std::forward<U>(item));
+        target->sequence.store(pos + 1, std::memory_order_release);
+        not_empty_->notify();
+        return true;
+    }
+
+    // claims up to 'count' consecutive free cells with one CAS. A cell seen
+    // free stays free until enqueue_pos_ moves past it, so the CAS validates
+    // the whole batch. Returns how many were pushed.
+    inline std::size_t try_push_n(const T* items, std::size_t count)
+    {
+        count = (count < CAPACITY ? count : CAPACITY);
+        std::size_t pos = enqueue_pos_->load(std::memory_order_relaxed);
+        for (;;)
+        {
+            std::size_t n = 0;
+            intptr_t diff = 0;
+            for (; n < count; ++n)
+            {
+                diff = (intptr_t)cells_[(pos + n) & MASK].sequence.load(std::memory_order_acquire) - (intptr_t)(pos + n);
+                if (diff != 0) break;
+            }
+            if (n == 0)
+            {
+                if (count == 0 || diff < 0) return 0; // full
+                pos = enqueue_pos_->load(std::memory_order_relaxed);
+                continue;
+            }
+            if (enqueue_pos_->compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    cell& target = cells_[(pos + i) & MASK];
+                    new (target.get()) T(items[i]);
+                    target.sequence.store(pos + i + 1, std::memory_order_release);
+                }
+                not_empty_->notify();
+                return n;
+            }
+        }
+    }
+
+    template <typename U>
+    inline void push(U&& item)
+    {
+        while (!try_push(std::forward<U>(item)))
+        {
+            not_full_->wait([this]() { return !full(); });
+        }
+    }
+    //}}}
+
+    //{{{ consumers
+    inline bool try_pop(T& item)
+    {
+        cell* target;
+        std::size_t pos = dequeue_pos_->load(std::memory_order_relaxed);
+        for (;;)
+        {
+            target = &cells_[pos & MASK];
+            const std::size_t seq = target->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_->compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_->load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(*target->get());
+        target->get()->~T();
+        target->sequence.store(pos + MASK + 1, std::memory_order_release);
+        not_full_->notify();
+        return true;
+    }
+
+    // same batching idea as try_push_n, on published cells
+    inline std::size_t try_pop_n(T* items, std::size_t count)
+    {
+        count = (count < CAPACITY ? count : CAPACITY);
+        std::size_t pos = dequeue_pos_->load(std::memory_order_relaxed);
+        for (;;)
+        {
+            std::size_t n = 0;
+            intptr_t diff = 0;
+            for (; n < count; ++n)
+            {
+                diff = (intptr_t)cells_[(pos + n) & MASK].sequence.load(std::memory_order_acquire) - (intptr_t)(pos + n + 1);
+                if (diff != 0) break;
+            }
+            if (n == 0)
+            {
+                if (count == 0 || diff < 0) return 0; // empty
+                pos = dequeue_pos_->load(std::memory_order_relaxed);
+                continue;
+            }
+            if (dequeue_pos_->compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+            {
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    cell& target = cells_[(pos + i) & MASK];
+                    items[i] = std::move(*target.get());
+                    target.get()->~T();
+                    target.sequence.store(pos + i + MASK + 1, std::memory_order_release);
+                }
+                not_full_->notify();
+                return n;
+            }
+        }
+    }
+
+    inline void pop(T& item)
+    {
+        while (!try_pop(item))
+        {
+            not_empty_->wait([this]() { return !empty(); });
+        }
+    }
+    //}}}
+
+    // approximate when called concurrently
+    inline std::size_t size() const
+    {
+        const std::size_t enq = enqueue_pos_->load(std::memory_order_acquire);
+        const std::size_t deq = dequeue_pos_->load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+    inline bool empty() const { return size() == 0; }
+    inline bool full() const { return size() >= CAPACITY; }
+    static constexpr std::size_t capacity() { return CAPACITY; }
+
+private:
+    // not copiable
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    cache_utils::cache_aligned<std::atomic<std::size_t>> enqueue_pos_;
+    cache_utils::cache_aligned<std::atomic<std::size_t>> dequeue_pos_;
+    cache_utils::cache_aligned<WAIT> not_empty_;
+    cache_utils::cache_aligned<WAIT> not_full_;
+    std::unique_ptr<cell[]> cells_;
+};
+//}}}
+
+} // namespace queues
@@ -4,6 +4,10 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <memory>  // std::allocator
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 
 namespace string_utils {
 
@@ -30,11 +34,27 @@ namespace string_utils {
      * {
      *     std::cout << "[" << i << "] -> [" << tok[i] << "]" << std::endl;
      * }
+     *
+     * The token positions are kept in a vector using 'Allocator'; it is only
+     * cleared between lines, so once it has grown to the largest token count
+     * seen, tokenize() does not allocate. To keep it off the global heap from
+     * the start, use string_utils::pmr::StringTokenizer with a memory resource
+     * (see arena.h), or reserve() up front.
+     * NOTE: the tokenizer outlives each line, so its resource must not be an
+     * arena rewound per line/message (scoped_rewind, rewind, reset): a vector
+     * grown inside such a scope is released under it and later overwritten.
+     * Give it its own resource, or reserve() the largest token count BEFORE
+     * taking the arena's first mark() (it then never grows again).
      */
-    template <std::size_t SIZE=1024>
+    template <std::size_t SIZE=1024, typename Allocator=std::allocator<std::size_t>>
     class StringTokenizer
     {
     public:
+        explicit StringTokenizer(const Allocator& allocator=Allocator()) : tokens_(allocator) {}
+
+        // pre-allocates room for 'tokens' tokens
+        inline void reserve(std::size_t tokens) { tokens_.reserve(tokens); }
+
         /** 
          * Breaks a line into tokens separated by 'separator'.
          * Returns the quantity of tokens found. This qty
@@ -53,14 +73,14 @@ namespace string_utils {
         
     private:
         // token position
-        std::vector<std::size_t> tokens_;
+        std::vector<std::size_t, Allocator> tokens_;
         char buf_[SIZE];
         std::size_t len_;
     };
 
     // tokenize
-    template<std::size_t SIZE>
-    inline size_t StringTokenizer<SIZE>::tokenize(const char* data, char separator)
+    template<std::size_t SIZE, typename Allocator>
+    inline size_t StringTokenizer<SIZE, Allocator>::tokenize(const char* data, char separator)
     {
         len_ = std::min(SIZE, strlen(data)+1);
         if ( len_ == 0 ) return 0;
@@ -102,13 +122,21 @@ namespace string_utils {
     }
 
     // operator[]
-    template<std::size_t SIZE>
-    const char* StringTokenizer<SIZE>::operator[](size_t index)
+    template<std::size_t SIZE, typename Allocator>
+    const char* StringTokenizer<SIZE, Allocator>::operator[](size_t index)
     {
         if ( index >= tokens_.size() ) return 0;
         return &buf_[tokens_[index]];
     }
 
+#if __cplusplus >= 201703L
+    namespace pmr {
+        // e.g.: string_utils::pmr::StringTokenizer<> tok(&resource);
+        template <std::size_t SIZE=1024>
+        using StringTokenizer = string_utils::StringTokenizer<SIZE, std::pmr::polymorphic_allocator<std::size_t>>;
+    } // namespace pmr
+#endif
+
 } // namespace string_utils
 
 #endif // STRINGTOKENIZER_H__
@@ -1,12 +1,22 @@
 #pragma once
 #include <string>
 #include <climits> // CHAR_BIT
+#include <utility> // std::move
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#include <string_view>
+#include "fixed_string.h"
+#endif
 #include "template_utils.h"
 
 namespace string_utils {
 inline namespace v2 {
 
-std::string trim_zeroes(std::string str, int target_length=0) 
+// The implementations are templated on the string type, so the std::string
+// API below and the allocator aware string_utils::pmr API share the code.
+namespace detail {
+template<typename String>
+constexpr String& trim_zeroes(String& str, int target_length)
 { 
     int i = 0; 
     while (str[i] == '0')
@@ -19,36 +29,35 @@ std::string trim_zeroes(std::string str, int target_length=0)
     return str.erase(0, i);
 }
 
-std::string pad_string(const std::string& input, int target_length=10, char padding_character='0', bool left_padding=true)
+// pads 'str' in place ('str' holds the input on entry)
+template<typename String>
+constexpr String& pad_string(String& str, int target_length, char padding_character, bool left_padding)
 {
-    std::string retval = input;
     int insert_length{0};
 
-    if (input.length() > target_length)
+    if (str.length() > target_length)
     {
         insert_length = target_length;
     }
     else
     {
-        insert_length = target_length - input.length();
+        insert_length = target_length - str.length();
     }
 
     if (left_padding)
     {
-        retval.insert(0, insert_length, padding_character);
+        str.insert(0, insert_length, padding_character);
     }
     else
     {
-        retval.insert(retval.end(), insert_length, padding_character);
+        str.append(insert_length, padding_character);
     }
-    return trim_zeroes(retval, target_length);
+    return trim_zeroes(str, target_length);
 }
 
-template<typename T>
-std::string get_binary_representation(const T& value, int pad_length=8, bool bitcap=false, std::size_t bits=0)
+template<typename T, typename String>
+String& get_binary_representation(String& count, const T& value, int pad_length, bool bitcap, std::size_t bits)
 {
-    std::string count;
-
     std::size_t bytes = sizeof(T);
 
     //auto loop_size = (bitcap?bits:bytes * CHAR_BIT);
@@ -71,10 +80,30 @@ std::string get_binary_representation(const T& value, int pad_length=8, bool bit
     {
         if (bit%8 == 0) ++byte;
         bool is_1 = (((ptr[byte])>>bit)&1);
-        count.insert(0, is_1 ? "1" : "0");
+        count.insert(0, 1, is_1 ? '1' : '0');
     }
-    return pad_string(count, pad_length, '0');
+    return pad_string(count, pad_length, '0', true);
+}
+} // namespace detail
+
+std::string trim_zeroes(std::string str, int target_length=0) 
+{ 
+    return std::move(detail::trim_zeroes(str, target_length));
+}
+
+std::string pad_string(const std::string& input, int target_length=10, char padding_character='0', bool left_padding=true)
+{
+    std::string retval = input;
+    return std::move(detail::pad_string(retval, target_length, padding_character, left_padding));
+}
+
+template<typename T>
+std::string get_binary_representation(const T& value, int pad_length=8, bool bitcap=false, std::size_t bits=0)
+{
+    std::string count;
+    return std::move(detail::get_binary_representation(count, value, pad_length, bitcap, bits));
 }
+
 //template<typename T>
 //std::string get_binary_representation(const T& value, int pad_length=8)
 //{
@@ -94,6 +123,92 @@ std::string get_binary_representation(const T& value, int pad_length=8, bool bit
 //}
 } // namespace v2
 
+#if __cplusplus >= 201703L
+// Same functions, but every string is allocated from 'resource' (e.g. an
+// allocators::arena_resource), so they do no global heap allocations.
+namespace pmr {
+
+inline std::pmr::string trim_zeroes(std::pmr::memory_resource* resource, std::string_view input, int target_length=0)
+{
+    std::pmr::string retval(input, resource);
+    return std::move(detail::trim_zeroes(retval, target_length));
+}
+
+inline std::pmr::string pad_string(std::pmr::memory_resource* resource, std::string_view input, int target_length=10, char padding_character='0', bool left_padding=true)
+{
+    std::pmr::string retval(resource);
+    retval.reserve(extrema::max<std::size_t>(input.length(), target_length) + target_length);
+    retval.assign(input);
+    return std::move(detail::pad_string(retval, target_length, padding_character, left_padding));
+}
+
+template<typename T>
+std::pmr::string get_binary_representation(std::pmr::memory_resource* resource, const T& value, int pad_length=8, bool bitcap=false, std::size_t bits=0)
+{
+    std::pmr::string count(resource);
+    count.reserve(extrema::max<std::size_t>(sizeof(T)<<3, pad_length) + pad_length);
+    return std::move(detail::get_binary_representation(count, value, pad_length, bitcap, bits));
+}
+
+} // namespace pmr
+
+// Same functions, producing a FixedString<N> (no heap at all; trim_zeroes and
+// pad_string are constexpr). N must hold the result: pad_length for the
+// binary representation, max(input, target_length) for padding.
+namespace fixed {
+
+template<std::size_t N, overflow_policy POLICY=overflow_policy::truncate>
+constexpr FixedString<N, POLICY> trim_zeroes(std::string_view input, int target_length=0)
+{
+    FixedString<N, POLICY> retval(input);
+    return detail::trim_zeroes(retval, target_length);
+}
+
+template<std::size_t N, overflow_policy POLICY=overflow_policy::truncate>
+constexpr FixedString<N, POLICY> pad_string(std::string_view input, int target_length=10, char padding_character='0', bool left_padding=true)
+{
+    // same result as detail::pad_string, without an intermediate string (which
+    // could truncate before POLICY sees it): the padded string is padding and
+    // input, the zeroes trim_zeroes would remove are skipped, the rest appended
+    const std::size_t length = input.length();
+    const std::size_t target = static_cast<std::size_t>(target_length);
+    const std::size_t insert_length = (length > target ? target : target - length);
+    const std::size_t total = length + insert_length;
+    auto at = [&](std::size_t i) {
+        if (left_padding) return i < insert_length ? padding_character : input[i - insert_length];
+        return i < length ? input[i] : padding_character;
+    };
+    std::size_t skip{0};
+    while (skip < total && at(skip) == '0')
+    {
+        if (target_length && (total - skip) <= target) break;
+        ++skip;
+    }
+
+    FixedString<N, POLICY> retval;
+    if (left_padding)
+    {
+        if (skip < insert_length) retval.append(insert_length - skip, padding_character);
+        retval.append(input.substr(skip > insert_length ? skip - insert_length : 0));
+    }
+    else
+    {
+        if (skip < length) retval.append(input.substr(skip));
+        retval.append(skip > length ? total - skip : insert_length, padding_character);
+    }
+    return retval;
+}
+
+template<std::size_t N, overflow_policy POLICY=overflow_policy::truncate, typename T>
+FixedString<N, POLICY> get_binary_representation(const T& value, int pad_length=8, bool bitcap=false, std::size_t bits=0)
+{
+    FixedString<(sizeof(T)<<3) + N> count;
+    return FixedString<N, POLICY>(detail::get_binary_representation(count, value, pad_length, bitcap, bits));
+}
+
+} // namespace fixed
+#endif
+
 namespace v1 {
 std::string pad_string(const std::string& input, int target_length=10, char padding_character='0', bool left_padding=true)
 {
@@ -190,6 +190,30 @@ struct is_structure_size_aligned
     enum { VALUE = (sizeof(T) == (sizeof(T)/N)*N) ? true : false };
 };
 
+//{{{ Cache line layout
+// NOTE: std::hardware_destructive_interference_size would be the portable way,
+// but GCC warns it is ABI unstable (-Winterference-size), so we pin it here.
+// 64 bytes holds for x86_64 and most ARMv8 cores (Apple M-series use 128).
+constexpr std::size_t CACHE_LINE_SIZE{64};
+
+template <typename T>
+struct is_cache_line_size_aligned
+{
+    enum { VALUE = is_structure_size_aligned<T, CACHE_LINE_SIZE>::VALUE };
+};
+
+// validates that the bytes [OFFSET, OFFSET+SIZE) live in a single cache line
+// (assuming the enclosing object starts at a cache line boundary, which the
+// ASSERT_FIELD* macros below check through alignof)
+template <std::size_t OFFSET, std::size_t SIZE, std::size_t LINE=CACHE_LINE_SIZE>
+struct is_within_cache_line
+{
+    static constexpr std::size_t first_line = OFFSET / LINE;
+    static constexpr std::size_t last_line = (OFFSET + (SIZE ? SIZE : 1) - 1) / LINE;
+    static constexpr bool value = (first_line == last_line);
+};
+//}}}
+
 //{{{ Array tools
 // Size of Array
 template <typename T, std::size_t N>
@@ -213,30 +237,8 @@ constexpr std::size_t array_size(T)
 //}}}
 
 //{{{ RAII-Guard-Pthread Lock
-/*
-#include <pthread.h>
-// pthread lock guard - RAII
-template <typename Mutex>
-struct pthread_lock_guard
-{
-
-    pthread_lock_guard(Mutex &mutex) : mutex_(mutex) 
-    {
-        ::pthread_mutex_lock(&mutex_);
-    }
-    ~pthread_lock_guard()
-    {
-        ::pthread_mutex_unlock(&mutex_);
-    }
-
-    private:
-    // not copiable
-    pthread_lock_guard& operator=(const pthread_lock_guard &) = delete;
-    pthread_lock_guard(const pthread_lock_guard &) = delete;
-    pthread_lock_guard() = delete;
-    Mutex & mutex_;
-};
-*/
+// Moved to locks.h: locks::lock_guard<Mutex> works with pthread_mutex_t as well
+// as the spin/ticket/mcs/adaptive locks defined there.
 //}}}
 
 //{{{ For SFINAE magic : see https://foonathan.net/2015/11/overload-resolution-4/
@@ -257,10 +259,12 @@ using void_t = typename voider<Ts...>::type;
 //}}}
 
 //{{{ Better static_assert messages, from: https://stackoverflow.com/questions/13837668/display-integer-at-compile-time-in-static-assert/45127063
+// NOTE: returns a narrow type on purpose, so N + 256 overflows and g++/clang
+// print a -Woverflow warning naming N ('... [with long unsigned int N = 72]')
 template<uint64_t N>
 struct TriggerOverflowWarning
 {
-    static constexpr uint64_t value() { return N + 256; }
+    static constexpr uint8_t value() { return N + 256; }
 };
 
 template <uint64_t N, uint64_t M, typename Enable = void>
@@ -272,6 +276,68 @@ struct CheckEqualityWithWarning
 template <uint64_t N, uint64_t M>
 struct CheckEqualityWithWarning<N, M, typename std::enable_if<N != M>::type>
 {
-    static constexpr bool value = (TriggerOverflowWarning<N>::value() == TriggerOverflowWarning<M>::value());
+    // both values are only there for the warnings (uint8_t wraps, so do not compare them)
+    static constexpr bool value = (TriggerOverflowWarning<N>::value() == TriggerOverflowWarning<M>::value()) && N == M;
+};
+
+// [A_FIRST, A_LAST] and [B_FIRST, B_LAST] must not overlap; warns with all 4 on failure
+template <uint64_t A_FIRST, uint64_t A_LAST, uint64_t B_FIRST, uint64_t B_LAST,
+          bool SEPARATE = (A_LAST < B_FIRST || B_LAST < A_FIRST)>
+struct CheckSeparateWithWarning
+{
+    static constexpr bool value = true;
+};
+
+template <uint64_t A_FIRST, uint64_t A_LAST, uint64_t B_FIRST, uint64_t B_LAST>
+struct CheckSeparateWithWarning<A_FIRST, A_LAST, B_FIRST, B_LAST, false>
+{
+    static constexpr bool value = (TriggerOverflowWarning<A_FIRST>::value() + TriggerOverflowWarning<A_LAST>::value() +
+                                   TriggerOverflowWarning<B_FIRST>::value() + TriggerOverflowWarning<B_LAST>::value()) < 0;
 };
 //}}}
+
+//{{{ Layout assertions for hot structures
+// Built on CheckEqualityWithWarning / CheckSeparateWithWarning, so next to the
+// static_assert a failure prints -Woverflow warnings naming the numbers, e.g.:
+//    required from 'constexpr const bool CheckEqualityWithWarning<72, 64>::value'
+//    warning: conversion ... changes value from '328' to '72' [-Woverflow]
+// -> sizeof is 72, not 64 (cache line indices for the field checks).
+//
+// Example:
+//    struct alignas(CACHE_LINE_SIZE) Stats { uint64_t hits; uint64_t misses; char pad[48]; };
+//    ASSERT_LAYOUT_SIZE(Stats, 64);
+//    ASSERT_LAYOUT_ALIGNMENT(Stats, CACHE_LINE_SIZE);
+//    ASSERT_FIELD_WITHIN_CACHE_LINE(Stats, misses);
+#define ASSERT_LAYOUT_SIZE(TYPE, SIZE) \
+    static_assert(CheckEqualityWithWarning<sizeof(TYPE), (SIZE)>::value, \
+                  "sizeof(" #TYPE ") != " #SIZE)
+
+#define ASSERT_LAYOUT_ALIGNMENT(TYPE, ALIGNMENT) \
+    static_assert(CheckEqualityWithWarning<alignof(TYPE), (ALIGNMENT)>::value, \
+                  "alignof(" #TYPE ") != " #ALIGNMENT)
+
+// Offsets only map to cache lines if TYPE starts on a line boundary, so the
+// two field checks below also require alignof(TYPE) to be a multiple of
+// CACHE_LINE_SIZE (alignas(CACHE_LINE_SIZE), or cache_utils::cache_aligned).
+#define ASSERT_LINE_ALIGNED_FOR_FIELD_CHECKS(TYPE) \
+    static_assert(alignof(TYPE) % CACHE_LINE_SIZE == 0, \
+                  #TYPE " is not cache line aligned, field to line mapping is unknown")
+
+// first and last cache line index of the field must be the same
+#define ASSERT_FIELD_WITHIN_CACHE_LINE(TYPE, FIELD) \
+    ASSERT_LINE_ALIGNED_FOR_FIELD_CHECKS(TYPE); \
+    static_assert(CheckEqualityWithWarning< \
+                      is_within_cache_line<offsetof(TYPE, FIELD), sizeof(TYPE::FIELD)>::first_line, \
+                      is_within_cache_line<offsetof(TYPE, FIELD), sizeof(TYPE::FIELD)>::last_line>::value, \
+                  #TYPE "::" #FIELD " straddles a cache line boundary")
+
+// two fields written by different threads must not share a cache line (false sharing)
+#define ASSERT_FIELDS_ON_SEPARATE_CACHE_LINES(TYPE, FIELD_A, FIELD_B) \
+    ASSERT_LINE_ALIGNED_FOR_FIELD_CHECKS(TYPE); \
+    static_assert(CheckSeparateWithWarning< \
+                      is_within_cache_line<offsetof(TYPE, FIELD_A), sizeof(TYPE::FIELD_A)>::first_line, \
+                      is_within_cache_line<offsetof(TYPE, FIELD_A), sizeof(TYPE::FIELD_A)>::last_line, \
+                      is_within_cache_line<offsetof(TYPE, FIELD_B), sizeof(TYPE::FIELD_B)>::first_line, \
+                      is_within_cache_line<offsetof(TYPE, FIELD_B), sizeof(TYPE::FIELD_B)>::last_line>::value, \
+                  #TYPE "::" #FIELD_A " and " #TYPE "::" #FIELD_B " share a cache line")
+//}}}
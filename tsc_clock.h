@@ -0,0 +1,238 @@
+#pragma once
+/* TSC based clock: cheap, thread-safe timestamps.
+
+   now() is a rdtsc plus a fixed-point multiply/shift (no syscall, no vDSO),
+   converted with parameters shared by all threads through a seqlock:
+        ns = base_ns + (((tsc - base_tsc) * mult) >> SHIFT)
+
+   - Calibration: at first use, against the underlying clock (CLOCK_ID), over
+     CALIBRATION_NS, taking the tightest of a few rdtsc/clock_gettime pairs.
+   - Resync: once RESYNC_NS have passed since the last sync, the first caller
+     to notice (others keep going) measures the error against CLOCK_ID and
+     sets mult so that the error is gone by the next resync. The clock slews,
+     it does not jump, so readings stay continuous. Only errors above STEP_NS
+     (e.g. CLOCK_REALTIME was set) are stepped: base_ns jumps, mult is kept,
+     and the rate is measured again from the step on.
+   - Without an invariant TSC (CPUID 80000007H:EDX[8]), or on non-x86, now()
+     just calls clock_gettime(CLOCK_ID).
+
+   std::chrono compatible:
+    auto stamp = clocks::tsc_clock::now();                  // CLOCK_REALTIME based
+    std::chrono::system_clock::time_point tp = clocks::tsc_clock::to_sys(stamp);
+    auto start = clocks::tsc_steady_clock::now();           // CLOCK_MONOTONIC based
+    auto elapsed = clocks::tsc_steady_clock::now() - start; // std::chrono::nanoseconds
+
+   To stamp messages even cheaper, store raw ticks() and convert later with
+   to_ns(ticks) (valid as long as the conversion happens close to the stamp,
+   i.e. within a resync interval or so).
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>       // clock_gettime
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#define TSC_CLOCK_X86__
+#endif
+#include "cpu_features.h" // has_invariant_tsc
+
+namespace clocks {
+
+template <clockid_t CLOCK_ID>
+class basic_tsc_clock
+{
+public:
+    // std::chrono clock requirements
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<basic_tsc_clock, duration>;
+    static constexpr bool is_steady = (CLOCK_ID == CLOCK_MONOTONIC);
+
+    static constexpr uint32_t SHIFT{32};
+    static constexpr int64_t CALIBRATION_NS{10000000};   // 10ms
+    static constexpr int64_t RESYNC_NS{1000000000};      // 1s
+    static constexpr int64_t STEP_NS{1000000};           // 1ms
+
+    static inline time_point now() noexcept { return time_point(duration(now_ns())); }
+
+    // nanoseconds since CLOCK_ID's epoch
+    static inline int64_t now_ns() noexcept
+    {
+        return to_ns(ticks());
+    }
+
+    static inline uint64_t ticks() noexcept
+    {
+#ifdef TSC_CLOCK_X86__
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // NOTE: without an invariant TSC, ignores 'tsc' and returns clock_gettime(CLOCK_ID)
+    static inline int64_t to_ns(uint64_t tsc) noexcept
+    {
+        state& s = instance();
+        if (!s.invariant) return clock_ns();
+        uint64_t base_tsc, mult;
+        int64_t base_ns;
+        uint32_t seq;
+        do
+        {
+            seq = s.seq.load(std::memory_order_acquire);
+            base_tsc = s.base_tsc.load(std::memory_order_relaxed);
+            base_ns = s.base_ns.load(std::memory_order_relaxed);
+            mult = s.mult.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != s.seq.load(std::memory_order_relaxed));
+
+        const int64_t delta = int64_t(tsc - base_tsc);
+        if (delta > s.resync_ticks.load(std::memory_order_relaxed)) sync();
+        if (delta < 0) return base_ns - int64_t((uint64_t(-delta) * (unsigned __int128)mult) >> SHIFT);
+        return base_ns + int64_t((uint64_t(delta) * (unsigned __int128)mult) >> SHIFT);
+    }
+
+    static inline std::chrono::system_clock::time_point to_sys(time_point tp) noexcept
+    {
+        static_assert(CLOCK_ID == CLOCK_REALTIME, "only CLOCK_REALTIME shares the system_clock epoch");
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(tp.time_since_epoch()));
+    }
+
+    // ticks per nanosecond, as currently used for conversions
+    static inline double ticks_per_ns() noexcept
+    {
+        return double(uint64_t(1) << SHIFT) / instance().mult.load(std::memory_order_relaxed);
+    }
+
+    static inline bool invariant_tsc() noexcept { return instance().invariant; }
+
+    // forces a resync now (e.g. right after the process is (re)pinned)
+    static inline void resync() noexcept { if (instance().invariant) sync(); }
+
+private:
+    struct state
+    {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint64_t> base_tsc{0};
+        std::atomic<int64_t> base_ns{0};
+        std::atomic<uint64_t> mult{0};        // ns per tick << SHIFT
+        std::atomic<bool> resyncing{false};
+        // as of the last sync, to measure the rate over the interval
+        uint64_t sync_tsc{0};
+        int64_t sync_ns{0};
+        std::atomic<int64_t> resync_ticks{0}; // read on the fast path
+        bool invariant{false};
+
+        state()
+        {
+            invariant = cpu_features::has_invariant_tsc();
+            if (!invariant) return;
+            uint64_t tsc0{}, tsc1{};
+            int64_t ns0{}, ns1{};
+            sample(tsc0, ns0);
+            do { sample(tsc1, ns1); } while (ns1 - ns0 < CALIBRATION_NS);
+            const uint64_t rate = uint64_t((((unsigned __int128)(ns1 - ns0)) << SHIFT) / (tsc1 - tsc0));
+            store(tsc1, ns1, rate);
+            sync_tsc = tsc1;
+            sync_ns = ns1;
+            resync_ticks.store(int64_t((((unsigned __int128)RESYNC_NS) << SHIFT) / rate), std::memory_order_relaxed);
+        }
+
+        // seqlock writer (callers hold 'resyncing', or are the constructor)
+        void store(uint64_t tsc, int64_t ns, uint64_t rate)
+        {
+            const uint32_t s = seq.load(std::memory_order_relaxed);
+            seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            base_tsc.store(tsc, std::memory_order_relaxed);
+            base_ns.store(ns, std::memory_order_relaxed);
+            mult.store(rate, std::memory_order_relaxed);
+            seq.store(s + 2, std::memory_order_release);
+        }
+    };
+
+    static inline state& instance() noexcept
+    {
+        static state s;
+        return s;
+    }
+
+    static inline int64_t clock_ns() noexcept
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_ID, &ts);
+        return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    // the tsc read the closest to clock_gettime (tightest of a few tries)
+    static inline void sample(uint64_t& tsc, int64_t& ns) noexcept
+    {
+        uint64_t best{~0ULL};
+        for (int i = 0; i < 5; ++i)
+        {
+            const uint64_t before = ticks();
+            const int64_t clock = clock_ns();
+            const uint64_t after = ticks();
+            if (after - before < best)
+            {
+                best = after - before;
+                tsc = before + (after - before) / 2;
+                ns = clock;
+            }
+        }
+    }
+
+    // off the fast path: one caller at a time, the others keep the current parameters
+    static void sync() noexcept __attribute__((noinline))
+    {
+        state& s = instance();
+        if (s.resyncing.exchange(true, std::memory_order_acquire)) return; // someone else is on it
+        uint64_t tsc{};
+        int64_t real_ns{};
+        sample(tsc, real_ns);
+
+        const uint64_t base_tsc = s.base_tsc.load(std::memory_order_relaxed);
+        const int64_t base_ns = s.base_ns.load(std::memory_order_relaxed);
+        const uint64_t mult = s.mult.load(std::memory_order_relaxed);
+        const int64_t predicted_ns = base_ns + int64_t(((tsc - base_tsc) * (unsigned __int128)mult) >> SHIFT);
+        const int64_t error = real_ns - predicted_ns;
+
+        if (error > STEP_NS || error < -STEP_NS)
+        { // the clock was set: step, keep the rate, and measure it again from here
+            s.store(tsc, real_ns, mult);
+            s.sync_tsc = tsc;
+            s.sync_ns = real_ns;
+            s.resyncing.store(false, std::memory_order_release);
+            return;
+        }
+
+        // measured rate since the last sync (only over an interval with no step),
+        // then skewed to absorb 'error' over the next interval
+        uint64_t rate = mult;
+        if (tsc > s.sync_tsc && real_ns > s.sync_ns)
+        {
+            const uint64_t measured = uint64_t((((unsigned __int128)(real_ns - s.sync_ns)) << SHIFT) / (tsc - s.sync_tsc));
+            if (measured) rate = measured;
+        }
+        s.sync_tsc = tsc;
+        s.sync_ns = real_ns;
+        const int64_t interval = int64_t((((unsigned __int128)RESYNC_NS) << SHIFT) / rate);
+        if (interval > 0) s.resync_ticks.store(interval, std::memory_order_relaxed);
+        const int64_t skew = (interval > 0 ? int64_t((((__int128)error) << SHIFT) / interval) : 0);
+        s.store(tsc, predicted_ns, (int64_t(rate) + skew > 0 ? uint64_t(int64_t(rate) + skew) : rate));
+        s.resyncing.store(false, std::memory_order_release);
+    }
+};
+
+template <clockid_t CLOCK_ID> constexpr bool basic_tsc_clock<CLOCK_ID>::is_steady;
+template <clockid_t CLOCK_ID> constexpr uint32_t basic_tsc_clock<CLOCK_ID>::SHIFT;
+template <clockid_t CLOCK_ID> constexpr int64_t basic_tsc_clock<CLOCK_ID>::CALIBRATION_NS;
+template <clockid_t CLOCK_ID> constexpr int64_t basic_tsc_clock<CLOCK_ID>::RESYNC_NS;
+template <clockid_t CLOCK_ID> constexpr int64_t basic_tsc_clock<CLOCK_ID>::STEP_NS;
+
+using tsc_clock = basic_tsc_clock<CLOCK_REALTIME>;
+using tsc_steady_clock = basic_tsc_clock<CLOCK_MONOTONIC>;
+
+} // namespace clocks